@@ -1,12 +1,19 @@
 #ifndef _CONFIG_H_
 #define _CONFIG_H_
 
-// we use only one HART (cpu) in fundamental experiments
-#define NCPU 1
+// maximum number of HARTs (cpus) used by the kernel (spike -p N). harts beyond NCPU are
+// parked at boot (see mentry.S).
+#define NCPU 4
 
 //interval of timer interrupt
 #define TIMER_INTERVAL 1000000
 
+// interval (in timer ticks) of the aging scan that samples PTE accessed/dirty bits
+#define WSS_SCAN_INTERVAL 4
+
+// interval (in timer ticks) of the same-page merging scan (kernel/ksm.c), 0 disables it
+#define KSM_SCAN_INTERVAL 8
+
 // the maximum memory space that PKE is allowed to manage
 #define PKE_MAX_ALLOWABLE_RAM 128 * 1024 * 1024
 
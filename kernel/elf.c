@@ -3,11 +3,16 @@
  * into the (emulated) memory.
  */
 
+#include <errno.h>
+
 #include "elf.h"
 #include "string.h"
 #include "riscv.h"
 #include "vmm.h"
 #include "pmm.h"
+#include "file.h"
+#include "klog.h"
+#include "util/functions.h"
 #include "spike_interface/spike_utils.h"
 
 #define MAXARGS 10
@@ -72,14 +77,17 @@ elf_status elf_load(elf_ctx *ctx) {
     if (ph_addr.type != ELF_PROG_LOAD) continue;
     if (ph_addr.memsz < ph_addr.filesz) return EL_ERR;
     if (ph_addr.vaddr + ph_addr.memsz < ph_addr.vaddr) return EL_ERR;
+    // a segment the loader cannot take is an error, not a panic: spawn loads the elf of
+    // any program into a new process (see spawn_bincode_from_host_elf).
+    if (ph_addr.memsz >= PGSIZE || ph_addr.vaddr >= MAXVA) return EL_ERR;
+    if (ph_addr.flags != (SEGMENT_READABLE|SEGMENT_EXECUTABLE) &&
+        ph_addr.flags != (SEGMENT_READABLE|SEGMENT_WRITABLE))
+      return EL_ERR;
+    if (lookup_pa(((elf_info *)ctx->info)->p->pagetable, ph_addr.vaddr)) return EL_ERR;
 
     // allocate memory before loading
     void *dest = elf_alloc_mb(ctx, ph_addr.vaddr, ph_addr.vaddr, ph_addr.memsz);
 
-    // actual loading
-    if (elf_fpread(ctx, dest, ph_addr.memsz, ph_addr.off) != ph_addr.memsz)
-      return EL_EIO;
-
     // record the vm region in proc->mapped_info
     int j;
     for( j=0; j<PGSIZE/sizeof(mapped_region); j++ )
@@ -89,14 +97,18 @@ elf_status elf_load(elf_ctx *ctx) {
     ((process*)(((elf_info*)(ctx->info))->p))->mapped_info[j].npages = 1;
     if( ph_addr.flags == (SEGMENT_READABLE|SEGMENT_EXECUTABLE) ){
       ((process*)(((elf_info*)(ctx->info))->p))->mapped_info[j].seg_type = CODE_SEGMENT;
-      sprint( "CODE_SEGMENT added at mapped info offset:%d\n", j );
+      klog_debug( "CODE_SEGMENT added at mapped info offset:%d\n", j );
     }else if ( ph_addr.flags == (SEGMENT_READABLE|SEGMENT_WRITABLE) ){
       ((process*)(((elf_info*)(ctx->info))->p))->mapped_info[j].seg_type = DATA_SEGMENT;
-      sprint( "DATA_SEGMENT added at mapped info offset:%d\n", j );
+      klog_debug( "DATA_SEGMENT added at mapped info offset:%d\n", j );
     }else
       panic( "unknown program segment encountered, segment flag:%d.\n", ph_addr.flags );
 
     ((process*)(((elf_info*)(ctx->info))->p))->total_mapped_region ++;
+
+    // actual loading
+    if (elf_fpread(ctx, dest, ph_addr.memsz, ph_addr.off) != ph_addr.memsz)
+      return EL_EIO;
   }
 
   return EL_OK;
@@ -166,69 +178,102 @@ void load_bincode_from_host_elf(struct process *p) {
   sprint("Application program entry point (virtual address): 0x%lx\n", p->trapframe->epc);
 }
 
+// bytes of the argument strings of a shell command
+#define ARGS_BUFSIZE 512
+
 //
-// load the elf of shell commands
+// the arguments of a shell command, copied out of the address space of the caller: exec
+// frees it before the new program is loaded.
 //
-void load_shell_bincode_from_host_elf(char ** argv){
-  // 1. specify the path of the shell command object
-  char path[30] = "./obj/";
-  strcat(path, user_va_to_pa(current->pagetable, argv[0]));
-  sprint("Shell application: %s\n", path);
-
-  // 2. re-alloc the current process
-  // 2.1. save old argv
-  char * oldargv[MAXARGS+1];
+typedef struct cmdline_t {
   int argc;
-  for ( argc = 0; user_va_to_pa(current->pagetable, argv[argc])!=0; ++ argc ){
-    oldargv[argc] = user_va_to_pa(current->pagetable, argv[argc]);
-  }
-  oldargv[argc] = 0;
-  // 2.2. reallocate the process
-  realloc_process(current->pid);
-  // 2.3. load the arguments
-  // ustack example ///////
-  // [0x7fffeff8] echo
-  // [0x7fffeff0] a
-  // [0x7fffefe8] 0
-  // [0x7fffefe0] 0x7fffefe8
-  // [0x7fffefd8] 0x7fffeff0
-  // [0x7fffefd0] 0x7fffeff8
-  // //////////////////////
-  // build ustack for argv
-  void * sp = (void *)current->trapframe->regs.sp;
-
-  for ( int i = 0; i <= argc; ++ i ){
-    sp -= 8;
-    if ( i != argc ){
-      strcpy(user_va_to_pa(current->pagetable, sp), oldargv[i]);
-    }else{  // add 0
-      *(uint64*)user_va_to_pa(current->pagetable, sp) = (uint64)oldargv[i];
-    }
-    oldargv[i] = sp;
+  char *argv[MAXARGS + 1];
+  char buf[ARGS_BUFSIZE];
+} cmdline;
+
+//
+// copy the arguments uargv (a NULL-terminated array at a user address of the current
+// process) to cl. returns -1 if they are too many or too long, or not mapped.
+//
+static int cmdline_copy(cmdline *cl, char **uargv) {
+  pagetable_t pt = current->pagetable;
+  int used = 0;
+
+  for (cl->argc = 0;; cl->argc++) {
+    char **slot = (char **)user_va_to_pa(pt, &uargv[cl->argc]);
+    if (!slot) return -1;
+    if (*slot == NULL) break;
+
+    char *s = (char *)user_va_to_pa(pt, *slot);
+    if (!s || cl->argc == MAXARGS) return -1;
+    int len = strlen(s) + 1;
+    if (used + len > ARGS_BUFSIZE) return -1;
+    memcpy(cl->buf + used, s, len);
+    cl->argv[cl->argc] = cl->buf + used;
+    used += len;
   }
-  // build ustack pointer for argv
-  for ( int i = 0; i <= argc; ++ i ){
-    sp -= 8;
-    *(uint64*)user_va_to_pa(current->pagetable, sp) = (uint64)oldargv[argc-i];
+  cl->argv[cl->argc] = NULL;
+  return 0;
+}
+
+//
+// put the arguments cl on the user stack of p for main(argc, argv): the strings at the top
+// (8-byte aligned), the argv array below them.
+//
+static void cmdline_push(process *p, cmdline *cl) {
+  uint64 sp = p->trapframe->regs.sp;
+  uint64 uargv[MAXARGS + 1];
+
+  for (int i = cl->argc - 1; i >= 0; i--) {
+    int len = strlen(cl->argv[i]) + 1;
+    sp -= ROUNDUP(len, 8);
+    memcpy(user_va_to_pa(p->pagetable, (void *)sp), cl->argv[i], len);
+    uargv[i] = sp;
   }
-  current->trapframe->regs.sp = (uint64)sp;
-  current->trapframe->regs.a0 = argc;  // main function arg number
-  current->trapframe->regs.a1 = (uint64)sp;
-  
-  // 3. load bincode from host elf
-  // elf loading
+  uargv[cl->argc] = 0;
+  sp -= (cl->argc + 1) * sizeof(uint64);
+  memcpy(user_va_to_pa(p->pagetable, (void *)sp), uargv, (cl->argc + 1) * sizeof(uint64));
+
+  p->trapframe->regs.sp = sp;
+  p->trapframe->regs.a0 = cl->argc;  // main function arg number
+  p->trapframe->regs.a1 = sp;
+}
+
+//
+// open the object of shell command name, ./obj/name on the host.
+//
+static spike_file_t *open_shell_program(const char *name) {
+  char path[64] = "./obj/";
+
+  if (strlen(name) >= sizeof(path) - strlen(path)) return ERR_PTR(-ENAMETOOLONG);
+  strcat(path, name);
+  return spike_file_open(path, O_RDONLY, 0);
+}
+
+//
+// load the elf of shell commands. argv is a user address of the current process, the
+// command is argv[0].
+//
+void load_shell_bincode_from_host_elf(char ** argv){
+  cmdline cl;
   elf_ctx elfloader;
   elf_info info;
 
-  info.f = spike_file_open(path, O_RDONLY, 0);
-  info.p = current;
+  // 1. save the arguments, the address space that holds them is reallocated below.
+  if (cmdline_copy(&cl, argv) != 0 || cl.argc == 0) panic("exec: bad arguments.\n");
+  sprint("Shell application: ./obj/%s\n", cl.argv[0]);
+
+  info.f = open_shell_program(cl.argv[0]);
   if (IS_ERR_VALUE(info.f)) panic("Fail on openning the input application program.\n");
 
-  // init elfloader
+  // 2. re-alloc the current process, and build its user stack for argv
+  realloc_process(current->pid);
+  cmdline_push(current, &cl);
+
+  // 3. load bincode from host elf
+  info.p = current;
   if (elf_init(&elfloader, &info) != EL_OK)
     panic("fail to init elfloader.\n");
-
-  // load elf
   if (elf_load(&elfloader) != EL_OK) panic("Fail on loading elf.\n");
 
   // entry (virtual) address
@@ -238,4 +283,39 @@ void load_shell_bincode_from_host_elf(char ** argv){
   spike_file_close( info.f );
 
   sprint("Application program entry point (virtual address): 0x%lx\n", current->trapframe->epc);
-}
\ No newline at end of file
+}
+
+//
+// create a process that runs shell command name with the arguments argv (a user address
+// of the current process), its address space built from the elf directly. returns NULL if
+// the program or the arguments are not right: the new process is freed again if the elf
+// turns out bad only while it is loaded.
+//
+process *spawn_bincode_from_host_elf(char *name, char **argv) {
+  cmdline cl;
+  elf_ctx elfloader;
+  elf_info info;
+
+  if (cmdline_copy(&cl, argv) != 0) return NULL;
+  info.f = open_shell_program(name);
+  if (IS_ERR_VALUE(info.f)) return NULL;
+  if (elf_init(&elfloader, &info) != EL_OK) {
+    spike_file_close(info.f);
+    return NULL;
+  }
+
+  info.p = alloc_process();
+  cmdline_push(info.p, &cl);
+  if (elf_load(&elfloader) != EL_OK) {
+    spike_file_close(info.f);
+    free_process(info.p);
+    files_destroy(info.p->pfiles);
+    reclaim_process(info.p);
+    return NULL;
+  }
+  info.p->trapframe->epc = elfloader.ehdr.entry;
+  spike_file_close(info.f);
+
+  klog_debug("spawn: process %d, entry point 0x%lx\n", info.p->pid, info.p->trapframe->epc);
+  return info.p;
+}
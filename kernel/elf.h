@@ -65,5 +65,6 @@ elf_status elf_load(elf_ctx *ctx);
 
 void load_bincode_from_host_elf(process *p);
 void load_shell_bincode_from_host_elf(char ** argv);
+process *spawn_bincode_from_host_elf(char *name, char **argv);
 
 #endif
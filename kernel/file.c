@@ -4,11 +4,15 @@
 #include "pmm.h"
 #include "riscv.h"
 #include "process.h"
+#include "klog.h"
 #include "util/functions.h"
 #include "util/string.h"
 #include "spike_interface/spike_file.h"
 #include "spike_interface/spike_utils.h"
 
+static struct file * files_lookup(struct files_struct * pfiles, int fd);
+static void files_drop(struct files_struct * pfiles, struct file * pfile);
+
 // ///////////////////////////////////
 // Access to the RAM Disk
 // ///////////////////////////////////
@@ -85,23 +89,18 @@ int do_open(char *pathname, int flags){
   return pfile->fd;
 }
 
+//
+// read file. returns the number of bytes read, or -1 if fd is not open.
+//
 int do_read(int fd, char *buf, uint64 count){
   // 根据 fd 找到 file
-  struct file * pfile = NULL;
-
-  for ( int i = 0; i < MAX_FILES; ++ i ){
-    pfile = &(current->pfiles->ofile[i]); // file entry
-    if ( pfile->fd == fd )
-      break;
-  }
+  struct file * pfile = files_lookup(current->pfiles, fd);
   if ( pfile == NULL )
-    panic("do_read: invalid fd!\n");
+    return -1;
 
   // 打开宿主机文件
-  if ( pfile->status == FD_HOST ){
-    host_read(fd, buf, count);
-    return 0;
-  }
+  if ( pfile->status == FD_HOST )
+    return host_read(fd, buf, count);
 
   // 打开PKE Device文件
   if ( pfile->readable == 0 ) // 如果不可读
@@ -109,42 +108,83 @@ int do_read(int fd, char *buf, uint64 count){
 
   char buffer[count+1];
 
-  vop_read(pfile->node, buffer, count);
+  int r = vop_read(pfile->node, buffer, count);
 
   strcpy(buf, buffer);
 
-  return 0;
+  return r;
 }
 
+//
+// write file. returns the number of bytes written, or -1 if fd is not open.
+//
 int do_write(int fd, char *buf, uint64 count){
   // 根据 fd 找到 file
-  struct file * pfile = NULL;
-
-  for ( int i = 0; i < MAX_FILES; ++ i ){
-    pfile = &(current->pfiles->ofile[i]); // file entry
-    if ( pfile->fd == fd )
-      break;
-  }
+  struct file * pfile = files_lookup(current->pfiles, fd);
   if ( pfile == NULL )
-    panic("do_write: invalid fd!\n");
+    return -1;
 
   // 打开宿主机文件
-  if ( pfile->status == FD_HOST ){
-    host_write(fd, buf, count);
-    return 0;
-  }
+  if ( pfile->status == FD_HOST )
+    return host_write(fd, buf, count);
 
   // 打开PKE Device文件
   if ( pfile->writable == 0 ) // 如果不可读
     panic("do_write: cannot write file!\n");
 
-  vop_write(pfile->node, buf, count);
+  return vop_write(pfile->node, buf, count);
+}
 
-  return 0;
+//
+// scatter/gather i/o on fd, at offset off, or at the file position if off is negative.
+// host files take one HTIF call per piece, RAM disk files go to the file system in one
+// call. returns the number of bytes moved, or -1.
+//
+int do_rwv(int fd, struct kiov *iov, int n, int64 off, int write){
+  struct file * pfile = NULL;
+  int done = 0;
+
+  for ( int i = 0; i < MAX_FILES; ++ i )
+    if ( current->pfiles->ofile[i].status != FD_NONE && current->pfiles->ofile[i].fd == fd ){
+      pfile = &(current->pfiles->ofile[i]);
+      break;
+    }
+  if ( pfile == NULL ) return -1;
+
+  if ( pfile->status == FD_HOST ){
+    for ( int i = 0; i < n; ++ i ){
+      int r;
+      if ( off < 0 && write )
+        r = host_write(fd, iov[i].base, iov[i].len);
+      else if ( off < 0 )
+        r = host_read(fd, iov[i].base, iov[i].len);
+      else if ( write )
+        r = host_pwrite(fd, iov[i].base, iov[i].len, off + done);
+      else
+        r = host_pread(fd, iov[i].base, iov[i].len, off + done);
+      if ( r < 0 ) return done ? done : -1;
+      done += r;
+      if ( r < iov[i].len ) break;
+    }
+    return done;
+  }
+
+  if ( pfile->status != FD_OPENED || !(write ? pfile->writable : pfile->readable) ) return -1;
+  uint64 pos = off < 0 ? pfile->off : off;
+  done = write ? vop_writev(pfile->node, iov, n, pos) : vop_readv(pfile->node, iov, n, pos);
+  if ( off < 0 && done > 0 ) pfile->off += done;
+  return done;
 }
 
+//
+// close file: the entry of fd is free again. returns -1 if fd is not open.
+//
 int do_close(int fd){
-  return -1;
+  struct file * pfile = files_lookup(current->pfiles, fd);
+  if ( pfile == NULL )
+    return -1;
+  files_drop(current->pfiles, pfile);
+  return 0;
 }
 
 // ///////////////////////////////////
@@ -174,10 +214,79 @@ struct files_struct * files_create(void){
       ++ pfiles->nfile;
     }
   }
-  sprint("FS: create a files_struct for process: nfile: %d\n", pfiles->nfile);
+  klog_debug("FS: create a files_struct for process: nfile: %d\n", pfiles->nfile);
   return pfiles;
 }
 
+static struct file * files_lookup(struct files_struct * pfiles, int fd){
+  for ( int i = 0; i < MAX_FILES; ++ i )
+    if ( pfiles->ofile[i].status != FD_NONE && pfiles->ofile[i].fd == fd )
+      return &pfiles->ofile[i];
+  return NULL;
+}
+
+//
+// check the file actions of spawn (see spawn.h) against the files of the parent: a dup2
+// needs an open descriptor, and a host file keeps its number (it is the host's descriptor).
+// returns -1 if one of them cannot be done.
+//
+int files_check_actions(struct files_struct * parent, struct spawn_action * acts, int n){
+  for ( int i = 0; i < n; ++ i ){
+    if ( acts[i].fd < 0 || acts[i].fd >= MAX_FILES ) return -1;
+    if ( acts[i].op == SPAWN_CLOSE ) continue;
+    if ( acts[i].op != SPAWN_DUP2 || acts[i].newfd < 0 || acts[i].newfd >= MAX_FILES ) return -1;
+
+    struct file * from = files_lookup(parent, acts[i].fd);
+    if ( from == NULL ) return -1;
+    if ( from->status == FD_HOST && acts[i].newfd != acts[i].fd ) return -1;
+  }
+  return 0;
+}
+
+static void files_drop(struct files_struct * pfiles, struct file * pfile){
+  if ( pfile->status == FD_OPENED ) -- pfile->node->ref;
+  pfile->status = FD_NONE;
+  pfile->ref = 0;
+  -- pfiles->nfile;
+}
+
+//
+// give child the open files of parent, with the file actions of spawn applied in order
+// (checked by files_check_actions). the entries are copied: the offsets of the two
+// processes move independently from here on.
+//
+void files_inherit(struct files_struct * child, struct files_struct * parent,
+                   struct spawn_action * acts, int n){
+  child->cwd = parent->cwd;
+  child->nfile = parent->nfile;
+  for ( int i = 0; i < MAX_FILES; ++ i ){
+    child->ofile[i] = parent->ofile[i];
+    if ( child->ofile[i].status == FD_OPENED ) ++ child->ofile[i].node->ref;
+  }
+
+  for ( int i = 0; i < n; ++ i ){
+    struct file * pfile = files_lookup(child, acts[i].fd);
+
+    if ( acts[i].op == SPAWN_CLOSE ){
+      if ( pfile ) files_drop(child, pfile);
+      continue;
+    }
+
+    // dup2: the parent's fd, as newfd in the child.
+    struct file * from = files_lookup(parent, acts[i].fd);
+    struct file * to = files_lookup(child, acts[i].newfd);
+    if ( to ) files_drop(child, to);
+    for ( int j = 0; to == NULL && j < MAX_FILES; ++ j )
+      if ( child->ofile[j].status == FD_NONE ) to = &child->ofile[j];
+    if ( to == NULL ) continue;
+
+    *to = *from;
+    to->fd = acts[i].newfd;
+    if ( to->status == FD_OPENED ) ++ to->node->ref;
+    ++ child->nfile;
+  }
+}
+
 //
 // destroy a files_struct for a process
 //
@@ -2,11 +2,21 @@
 #define _FILE_H_
 
 #include "process.h"
+#include "spawn.h"
 #include "util/types.h"
 #include "spike_interface/spike_file.h"
 
 #define MASK_FILEMODE 0x003
 
+// a piece of a scatter/gather i/o vector, at a kernel (physical) address. the user buffers
+// are split at page boundaries, and physically contiguous pages are merged again.
+struct kiov {
+  char *base;
+  uint64 len;
+};
+// most pieces handed to the file system at once
+#define KIOV_MAX 32
+
 // //////////////////////////////////////////////////
 // File operation interfaces provided to the process
 // //////////////////////////////////////////////////
@@ -15,6 +25,7 @@ int do_open(char *pathname, int flags);
 int do_read(int fd, char *buf, uint64 count);
 int do_write(int fd, char *buf, uint64 count);
 int do_close(int fd);
+int do_rwv(int fd, struct kiov *iov, int n, int64 off, int write);
 
 // ///////////////////////////////////
 // Access to the RAM Disk
@@ -59,8 +70,9 @@ struct files_struct {
 
 struct files_struct * files_create(void);
 void files_destroy(struct files_struct * pfiles);
+int files_check_actions(struct files_struct * parent, struct spawn_action * acts, int n);
+void files_inherit(struct files_struct * child, struct files_struct * parent,
+                   struct spawn_action * acts, int n);
 
-// current running process
-extern process* current;
 
 #endif
@@ -0,0 +1,397 @@
+/*
+ * lazy switching of the floating point (F/D) and vector (V) state. user code starts with
+ * both units off. the first instruction that uses one traps (illegal instruction), and
+ * fpu_trap loads the state of the process, or clears the registers for a first user. the
+ * state is saved only when the process has dirtied it, as it leaves the hart. it is not
+ * restored at all when the process comes back to a hart whose registers still hold it, so
+ * processes that never touch the units pay nothing, and one that runs alone pays once.
+ */
+
+#include "fpu.h"
+#include "vmm.h"
+#include "pmm.h"
+#include "string.h"
+#include "spike_interface/spike_utils.h"
+
+// the process whose state the registers of each unit of each hart hold, as long as its
+// fpu_cpu still names the hart (it may have loaded the state on another hart since)
+static process *fpu_owner[FPU_UNITS][NCPU];
+// the units the harts implement
+static int fpu_present[FPU_UNITS];
+// bytes per vector register
+static uint64 vlenb;
+
+// position of the FS and VS fields in sstatus
+static const int status_shift[FPU_UNITS] = { 13, 9 };
+
+static inline int unit_status(int u) { return (read_csr(sstatus) >> status_shift[u]) & 3; }
+
+static inline void set_unit_status(int u, uint64 status) {
+  uint64 x = read_csr(sstatus) & ~(3UL << status_shift[u]);
+  write_csr(sstatus, x | status << status_shift[u]);
+}
+
+static void fp_save(fp_state *fp) {
+  asm volatile(
+      "fsd f0, 0(%0)\n"
+      "fsd f1, 8(%0)\n"
+      "fsd f2, 16(%0)\n"
+      "fsd f3, 24(%0)\n"
+      "fsd f4, 32(%0)\n"
+      "fsd f5, 40(%0)\n"
+      "fsd f6, 48(%0)\n"
+      "fsd f7, 56(%0)\n"
+      "fsd f8, 64(%0)\n"
+      "fsd f9, 72(%0)\n"
+      "fsd f10, 80(%0)\n"
+      "fsd f11, 88(%0)\n"
+      "fsd f12, 96(%0)\n"
+      "fsd f13, 104(%0)\n"
+      "fsd f14, 112(%0)\n"
+      "fsd f15, 120(%0)\n"
+      "fsd f16, 128(%0)\n"
+      "fsd f17, 136(%0)\n"
+      "fsd f18, 144(%0)\n"
+      "fsd f19, 152(%0)\n"
+      "fsd f20, 160(%0)\n"
+      "fsd f21, 168(%0)\n"
+      "fsd f22, 176(%0)\n"
+      "fsd f23, 184(%0)\n"
+      "fsd f24, 192(%0)\n"
+      "fsd f25, 200(%0)\n"
+      "fsd f26, 208(%0)\n"
+      "fsd f27, 216(%0)\n"
+      "fsd f28, 224(%0)\n"
+      "fsd f29, 232(%0)\n"
+      "fsd f30, 240(%0)\n"
+      "fsd f31, 248(%0)\n"
+      "frcsr t0\n"
+      "sd t0, 256(%0)\n"
+      : : "r"(fp) : "t0", "memory");
+}
+
+static void fp_restore(fp_state *fp) {
+  asm volatile(
+      "fld f0, 0(%0)\n"
+      "fld f1, 8(%0)\n"
+      "fld f2, 16(%0)\n"
+      "fld f3, 24(%0)\n"
+      "fld f4, 32(%0)\n"
+      "fld f5, 40(%0)\n"
+      "fld f6, 48(%0)\n"
+      "fld f7, 56(%0)\n"
+      "fld f8, 64(%0)\n"
+      "fld f9, 72(%0)\n"
+      "fld f10, 80(%0)\n"
+      "fld f11, 88(%0)\n"
+      "fld f12, 96(%0)\n"
+      "fld f13, 104(%0)\n"
+      "fld f14, 112(%0)\n"
+      "fld f15, 120(%0)\n"
+      "fld f16, 128(%0)\n"
+      "fld f17, 136(%0)\n"
+      "fld f18, 144(%0)\n"
+      "fld f19, 152(%0)\n"
+      "fld f20, 160(%0)\n"
+      "fld f21, 168(%0)\n"
+      "fld f22, 176(%0)\n"
+      "fld f23, 184(%0)\n"
+      "fld f24, 192(%0)\n"
+      "fld f25, 200(%0)\n"
+      "fld f26, 208(%0)\n"
+      "fld f27, 216(%0)\n"
+      "fld f28, 224(%0)\n"
+      "fld f29, 232(%0)\n"
+      "fld f30, 240(%0)\n"
+      "fld f31, 248(%0)\n"
+      "ld t0, 256(%0)\n"
+      "fscsr t0\n"
+      : : "r"(fp) : "t0", "memory");
+}
+
+static void fp_clear() {
+  asm volatile(
+      "fmv.d.x f0, zero\n"
+      "fmv.d.x f1, zero\n"
+      "fmv.d.x f2, zero\n"
+      "fmv.d.x f3, zero\n"
+      "fmv.d.x f4, zero\n"
+      "fmv.d.x f5, zero\n"
+      "fmv.d.x f6, zero\n"
+      "fmv.d.x f7, zero\n"
+      "fmv.d.x f8, zero\n"
+      "fmv.d.x f9, zero\n"
+      "fmv.d.x f10, zero\n"
+      "fmv.d.x f11, zero\n"
+      "fmv.d.x f12, zero\n"
+      "fmv.d.x f13, zero\n"
+      "fmv.d.x f14, zero\n"
+      "fmv.d.x f15, zero\n"
+      "fmv.d.x f16, zero\n"
+      "fmv.d.x f17, zero\n"
+      "fmv.d.x f18, zero\n"
+      "fmv.d.x f19, zero\n"
+      "fmv.d.x f20, zero\n"
+      "fmv.d.x f21, zero\n"
+      "fmv.d.x f22, zero\n"
+      "fmv.d.x f23, zero\n"
+      "fmv.d.x f24, zero\n"
+      "fmv.d.x f25, zero\n"
+      "fmv.d.x f26, zero\n"
+      "fmv.d.x f27, zero\n"
+      "fmv.d.x f28, zero\n"
+      "fmv.d.x f29, zero\n"
+      "fmv.d.x f30, zero\n"
+      "fmv.d.x f31, zero\n"
+      "fscsr zero\n");
+}
+
+//
+// whole register moves (vs8r.v, vl8re8.v) ignore vl and vtype, which are saved apart and
+// set again with vsetvl.
+//
+static void vec_save(vec_state *vec) {
+  asm volatile(
+      ".option push\n"
+      ".option arch, +v\n"
+      "csrr t0, vstart\n"
+      "sd t0, 0(%0)\n"
+      "csrr t0, vl\n"
+      "sd t0, 8(%0)\n"
+      "csrr t0, vtype\n"
+      "sd t0, 16(%0)\n"
+      "csrr t0, vcsr\n"
+      "sd t0, 24(%0)\n"
+      "csrw vstart, zero\n"
+      "mv t0, %1\n"
+      "vs8r.v v0, (t0)\n"
+      "add t0, t0, %2\n"
+      "vs8r.v v8, (t0)\n"
+      "add t0, t0, %2\n"
+      "vs8r.v v16, (t0)\n"
+      "add t0, t0, %2\n"
+      "vs8r.v v24, (t0)\n"
+      ".option pop\n"
+      : : "r"(vec), "r"(vec->regs), "r"(8 * vlenb) : "t0", "memory");
+}
+
+static void vec_restore(vec_state *vec) {
+  asm volatile(
+      ".option push\n"
+      ".option arch, +v\n"
+      "csrw vstart, zero\n"
+      "mv t0, %1\n"
+      "vl8re8.v v0, (t0)\n"
+      "add t0, t0, %2\n"
+      "vl8re8.v v8, (t0)\n"
+      "add t0, t0, %2\n"
+      "vl8re8.v v16, (t0)\n"
+      "add t0, t0, %2\n"
+      "vl8re8.v v24, (t0)\n"
+      "ld t0, 8(%0)\n"
+      "ld t1, 16(%0)\n"
+      "vsetvl zero, t0, t1\n"
+      "ld t0, 24(%0)\n"
+      "csrw vcsr, t0\n"
+      "ld t0, 0(%0)\n"
+      "csrw vstart, t0\n"
+      ".option pop\n"
+      : : "r"(vec), "r"(vec->regs), "r"(8 * vlenb) : "t0", "t1", "memory");
+}
+
+//
+// save unit u of this hart to its owner, if the owner dirtied it.
+//
+static void unit_flush(int u) {
+  process *owner = fpu_owner[u][cpuid()];
+
+  if (unit_status(u) != FPU_DIRTY) return;
+  if (u == FPU_FP)
+    fp_save(&owner->fp);
+  else
+    vec_save(&owner->vec);
+  owner->fpu_used[u] = 1;
+  set_unit_status(u, FPU_CLEAN);
+}
+
+//
+// load the state of proc into unit u of this hart. the unit is on while the registers are
+// written, and left initial (a first user) or clean.
+//
+static void unit_load(int u, process *proc) {
+  set_unit_status(u, FPU_DIRTY);
+  if (u == FPU_FP) {
+    if (proc->fpu_used[u])
+      fp_restore(&proc->fp);
+    else
+      fp_clear();
+  } else {
+    if (!proc->vec.regs) proc->vec.regs = alloc_page();
+    if (!proc->fpu_used[u]) {
+      // vl 0 and vtype e8 (0), zeroed registers.
+      proc->vec.vstart = proc->vec.vl = proc->vec.vtype = proc->vec.vcsr = 0;
+      memset(proc->vec.regs, 0, 32 * vlenb);
+    }
+    vec_restore(&proc->vec);
+  }
+  fpu_owner[u][cpuid()] = proc;
+  proc->fpu_cpu[u] = cpuid();
+  set_unit_status(u, proc->fpu_used[u] ? FPU_CLEAN : FPU_INITIAL);
+}
+
+//
+// find the units the harts implement. called on hart 0 at boot.
+//
+void fpu_init() {
+  fpu_present[FPU_FP] = isa_has_letter('d');
+  fpu_present[FPU_VEC] = isa_has_letter('v');
+
+  if (fpu_present[FPU_VEC]) {
+    set_unit_status(FPU_VEC, FPU_INITIAL);
+    asm volatile(".option push\n.option arch, +v\ncsrr %0, vlenb\n.option pop" : "=r"(vlenb));
+    set_unit_status(FPU_VEC, FPU_OFF);
+    if (32 * vlenb > PGSIZE) panic("fpu_init: vector registers of %ld bytes.\n", vlenb);
+  }
+  sprint("fpu: floating point %s, vector %s.\n", fpu_present[FPU_FP] ? "on" : "off",
+         fpu_present[FPU_VEC] ? "on" : "off");
+}
+
+//
+// next goes to user mode on this hart. the units stay as they are if their registers hold
+// the state of next. otherwise the state of the previous owner is saved (if dirty), and the
+// units are off until next uses them.
+//
+void fpu_switch(process *next) {
+  int hart = cpuid();
+
+  for (int u = 0; u < FPU_UNITS; u++) {
+    if (!fpu_present[u]) continue;
+    if (fpu_owner[u][hart] == next && next->fpu_cpu[u] == hart) continue;
+    unit_flush(u);
+    set_unit_status(u, FPU_OFF);
+  }
+}
+
+//
+// the hart goes idle: save the dirty state of the process that ran last, which another
+// hart may run once the kernel lock is released.
+//
+void fpu_release() {
+  for (int u = 0; u < FPU_UNITS; u++) {
+    if (!fpu_present[u]) continue;
+    unit_flush(u);
+    set_unit_status(u, FPU_OFF);
+  }
+}
+
+//
+// the units an instruction uses (a bit per unit). compressed instructions only reach the
+// floating point registers by c.fld, c.fsd, c.fldsp and c.fsdsp (rv64).
+//
+static int insn_units(uint32 insn) {
+  uint32 opcode = insn & 0x7f, funct3 = (insn >> 12) & 7, csr = insn >> 20;
+
+  if ((insn & 3) != 3) {
+    uint32 quadrant = insn & 3, cfunct3 = (insn >> 13) & 7;
+    return quadrant != 1 && (cfunct3 == 1 || cfunct3 == 5) ? 1 << FPU_FP : 0;
+  }
+
+  switch (opcode) {
+    case 0x07:  // LOAD-FP and STORE-FP: widths 1-4 are scalar, the others vector
+    case 0x27:
+      return funct3 >= 1 && funct3 <= 4 ? 1 << FPU_FP : 1 << FPU_VEC;
+    case 0x43:  // fused multiply-add
+    case 0x47:
+    case 0x4b:
+    case 0x4f:
+    case 0x53:  // OP-FP
+      return 1 << FPU_FP;
+    case 0x57:  // OP-V, its floating point forms (OPFVV, OPFVF) also need F
+      return funct3 == 1 || funct3 == 5 ? 1 << FPU_FP | 1 << FPU_VEC : 1 << FPU_VEC;
+    case 0x73:  // csr access: fflags, frm, fcsr; vstart, vxsat, vxrm, vcsr, vl, vtype, vlenb
+      if (funct3 == 0 || funct3 == 4) return 0;
+      if (csr >= 0x001 && csr <= 0x003) return 1 << FPU_FP;
+      if ((csr >= 0x008 && csr <= 0x00a) || csr == 0x00f || (csr >= 0xc20 && csr <= 0xc22))
+        return 1 << FPU_VEC;
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+//
+// an illegal instruction of proc, insn as reported in stval (0 if the hart does not report
+// it). returns 1 if it uses a unit that was off and is now on, and can be run again.
+//
+int fpu_trap(process *proc, uint64 insn) {
+  uint64 epc = proc->trapframe->epc;
+  int hart = cpuid(), loaded = 0;
+
+  if (insn == 0) {
+    uint16 *lo = (uint16 *)user_va_to_pa(proc->pagetable, (void *)epc);
+    if (!lo) return 0;
+    insn = *lo;
+    // the upper half may be on the next page.
+    if ((insn & 3) == 3) {
+      uint16 *hi = (uint16 *)user_va_to_pa(proc->pagetable, (void *)(epc + 2));
+      if (!hi) return 0;
+      insn |= (uint64)*hi << 16;
+    }
+  }
+
+  int units = insn_units(insn);
+  for (int u = 0; u < FPU_UNITS; u++) {
+    if (!(units & (1 << u)) || !fpu_present[u] || unit_status(u) != FPU_OFF) continue;
+    // the registers may still hold the state, from the last time proc ran here.
+    if (fpu_owner[u][hart] == proc && proc->fpu_cpu[u] == hart)
+      set_unit_status(u, proc->fpu_used[u] ? FPU_CLEAN : FPU_INITIAL);
+    else
+      unit_load(u, proc);
+    loaded = 1;
+  }
+  return loaded;
+}
+
+//
+// give child a copy of the state of parent, the current process.
+//
+void fpu_fork(process *parent, process *child) {
+  void *regs = child->vec.regs;
+
+  for (int u = 0; u < FPU_UNITS; u++) {
+    if (fpu_present[u] && fpu_owner[u][cpuid()] == parent) unit_flush(u);
+    child->fpu_used[u] = parent->fpu_used[u];
+    child->fpu_cpu[u] = -1;
+  }
+
+  child->fp = parent->fp;
+  child->vec = parent->vec;
+  child->vec.regs = regs;
+  if (parent->fpu_used[FPU_VEC]) {
+    if (!child->vec.regs) child->vec.regs = alloc_page();
+    memcpy(child->vec.regs, parent->vec.regs, 32 * vlenb);
+  }
+}
+
+//
+// drop the state of proc, which gets a new image (exec) or is new. if the registers of
+// this hart hold it, they are given up.
+//
+void fpu_reset(process *proc) {
+  for (int u = 0; u < FPU_UNITS; u++) {
+    if (fpu_present[u] && fpu_owner[u][cpuid()] == proc) {
+      fpu_owner[u][cpuid()] = NULL;
+      set_unit_status(u, FPU_OFF);
+    }
+    proc->fpu_cpu[u] = -1;
+    proc->fpu_used[u] = 0;
+  }
+}
+
+//
+// free the vector registers of a reaped process.
+//
+void fpu_free(process *proc) {
+  if (proc->vec.regs) free_page(proc->vec.regs);
+  proc->vec.regs = NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include "process.h"
+
+// values of the FS and VS fields of sstatus
+#define FPU_OFF 0
+#define FPU_INITIAL 1
+#define FPU_CLEAN 2
+#define FPU_DIRTY 3
+
+void fpu_init();
+void fpu_switch(process *next);
+void fpu_release();
+int fpu_trap(process *proc, uint64 insn);
+void fpu_fork(process *parent, process *child);
+void fpu_reset(process *proc);
+void fpu_free(process *proc);
+
+#endif
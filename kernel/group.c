@@ -0,0 +1,145 @@
+/*
+ * cpu bandwidth groups: the processes of a group share a quota of processor time in every
+ * period. the scheduler charges their runtime here (see update_runtime in sched.c), and
+ * throttles them once the quota is spent; the period timer refills the quota and lets them
+ * run again.
+ */
+
+#include "group.h"
+#include "sched.h"
+#include "string.h"
+#include "spike_interface/spike_utils.h"
+
+// group 0, the root group, has no limit
+cpu_group cpu_groups[NGROUP] = { [0] = { .in_use = 1 } };
+
+//
+// a new period of group starts: refill its quota, and release its throttled processes.
+//
+static void group_refill(ktimer *t) {
+  cpu_group *group = (cpu_group *)t->data;
+  uint64 now = read_time();
+
+  group->period_start += group->period;
+  // periods that went by without any process of the group are skipped.
+  if ((int64)(now - (group->period_start + group->period)) >= 0) group->period_start = now;
+  group->runtime_left = group->quota;
+
+  if (group->throttled) {
+    group->throttled = 0;
+    group->throttled_time += now - group->throttled_since;
+    wakeup(&group->throttled_wq);
+  }
+
+  // an empty group stops its timer, group_attach starts it again.
+  if (group->quota && group->nr_procs > 0)
+    timer_add(t, time_to_jiffy_up(group->period_start + group->period));
+}
+
+static void group_start_timer(cpu_group *group) {
+  if (!group->quota || timer_pending(&group->period_timer)) return;
+
+  group->period_start = read_time();
+  group->runtime_left = group->quota;
+  group->period_timer.func = group_refill;
+  group->period_timer.data = group;
+  timer_add(&group->period_timer, time_to_jiffy_up(group->period_start + group->period));
+}
+
+//
+// move proc to group.
+//
+void group_attach(process *proc, cpu_group *group) {
+  if (proc->group) group_detach(proc);
+  proc->group = group;
+  group->nr_procs++;
+  group_start_timer(group);
+}
+
+//
+// take proc out of its group. an exiting process leaves it in free_process, while it is
+// still the current process: it has no group for the rest of its run.
+//
+void group_detach(process *proc) {
+  if (!proc->group) return;
+  proc->group->nr_procs--;
+  proc->group = NULL;
+}
+
+//
+// charge delta (rdtime units) of processor time used by proc to its group, if it still
+// has one (see group_detach).
+//
+void group_charge(process *proc, uint64 delta) {
+  cpu_group *group = proc->group;
+
+  if (!group) return;
+  group->usage += delta;
+  if (group->quota) group->runtime_left -= delta;
+}
+
+//
+// tell whether proc has to be throttled: its group spent the quota of the period. deadline
+// processes are limited by their own runtime, and are not throttled.
+//
+int group_over_quota(process *proc) {
+  cpu_group *group = proc->group;
+  return group && group->quota && group->runtime_left <= 0 && !proc->dl_period;
+}
+
+//
+// note that the processes of group are throttled from now on.
+//
+void group_set_throttled(cpu_group *group) {
+  if (group->throttled) return;
+  group->throttled = 1;
+  group->throttled_since = read_time();
+  group->nr_throttled++;
+}
+
+//
+// create a group whose processes may run for quota in every period (rdtime units, quota 0
+// for no limit). returns its id, or -1.
+//
+int group_create(uint64 quota, uint64 period) {
+  if (quota && (period == 0 || quota > period * NCPU)) return -1;
+
+  for (int id = 1; id < NGROUP; id++) {
+    cpu_group *group = &cpu_groups[id];
+    if (group->in_use) continue;
+
+    memset(group, 0, sizeof(*group));
+    group->in_use = 1;
+    group->quota = quota;
+    group->period = period;
+    return id;
+  }
+  return -1;
+}
+
+//
+// move the current process to group id. returns -1 if there is no such group.
+//
+int group_join(int id) {
+  if (id < 0 || id >= NGROUP || !cpu_groups[id].in_use) return -1;
+  group_attach(current, &cpu_groups[id]);
+  return 0;
+}
+
+//
+// fill st with the usage of group id. returns -1 if there is no such group.
+//
+int group_getstat(int id, struct group_stat *st) {
+  if (id < 0 || id >= NGROUP || !cpu_groups[id].in_use) return -1;
+  cpu_group *group = &cpu_groups[id];
+  uint64 throttled = group->throttled_time;
+
+  if (group->throttled) throttled += read_time() - group->throttled_since;
+  st->quota = time_to_ns(group->quota);
+  st->period = time_to_ns(group->period);
+  st->usage = time_to_ns(group->usage);
+  st->throttled = time_to_ns(throttled);
+  st->nr_throttled = group->nr_throttled;
+  st->nr_procs = group->nr_procs;
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _GROUP_H_
+#define _GROUP_H_
+
+#include "process.h"
+
+// number of cpu groups, group 0 holds every process that did not join another one
+#define NGROUP 8
+
+//
+// a cpu bandwidth group: its processes together may run for quota in every period (both in
+// rdtime units). once the quota is spent, they are throttled until the next period starts.
+// a process joins the group of its parent at fork.
+//
+typedef struct cpu_group {
+  int in_use;
+  int nr_procs;            // live processes in the group
+  uint64 quota, period;    // quota 0: no limit
+  int64 runtime_left;      // quota left in the current period
+  uint64 period_start;     // rdtime at the start of the current period
+  ktimer period_timer;     // refills the quota at the end of the period
+
+  int throttled;           // set while the processes wait for the next period
+  wait_queue throttled_wq; // the throttled processes
+  uint64 throttled_since;
+
+  // statistics, in rdtime units
+  uint64 usage;            // processor time used by the processes
+  uint64 throttled_time;   // time spent throttled
+  uint64 nr_throttled;     // periods in which the group was throttled
+} cpu_group;
+
+extern cpu_group cpu_groups[NGROUP];
+
+void group_attach(process *proc, cpu_group *group);
+void group_detach(process *proc);
+void group_charge(process *proc, uint64 delta);
+int group_over_quota(process *proc);
+void group_set_throttled(cpu_group *group);
+
+int group_create(uint64 quota, uint64 period);
+int group_join(int id);
+int group_getstat(int id, struct group_stat *st);
+
+#endif
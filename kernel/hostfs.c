@@ -26,6 +26,16 @@ int host_write(int fd, char *buf, uint64 count) {
   return spike_file_write(f, buf, count);
 }
 
+int host_pread(int fd, char *buf, uint64 count, uint64 off) {
+  spike_file_t *f = spike_file_get(fd);
+  return spike_file_pread(f, buf, count, off);
+}
+
+int host_pwrite(int fd, char *buf, uint64 count, uint64 off) {
+  spike_file_t *f = spike_file_get(fd);
+  return spike_file_pwrite(f, buf, count, off);
+}
+
 int host_close(int fd) {
   spike_file_t *f = spike_file_get(fd);
   return spike_file_close(f);
@@ -12,6 +12,8 @@
 int host_open(char *pathname, int flags);
 int host_read(int fd, char *buf, uint64 count);
 int host_write(int fd, char *buf, uint64 count);
+int host_pread(int fd, char *buf, uint64 count, uint64 off);
+int host_pwrite(int fd, char *buf, uint64 count, uint64 off);
 int host_close(int fd);
 
 #endif
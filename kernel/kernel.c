@@ -11,6 +11,10 @@
 #include "file.h"
 #include "sched.h"
 #include "memlayout.h"
+#include "smp.h"
+#include "syscall.h"
+#include "fpu.h"
+#include "klog.h"
 #include "spike_interface/spike_utils.h"
 
 //
@@ -45,11 +49,34 @@ process* load_user_program( ) {
   return proc;
 }
 
+// set by hart 0 once the kernel is initialized, the other harts wait for it
+static volatile int sboot_done = 0;
+
+//
+// entry of the harts other than hart 0, which run processes queued by hart 0.
+//
+static void s_start_secondary(void) {
+  while (!sboot_done)
+    ;
+  enable_paging();
+  vdso_hart_init();
+
+  kernel_lock();
+  sprint("hart %d: enter supervisor mode.\n", cpuid());
+  g_cpu_online[cpuid()] = 1;
+  schedule();
+}
+
 //
 // s_start: S-mode entry point of PKE OS kernel.
 //
 int s_start(void) {
+  if (cpuid() != 0) s_start_secondary();
+
   sprint("Enter supervisor mode...\n");
+  // the levels of the kernel log (loglevel=, console_loglevel=)
+  klog_init();
+
   // in the beginning, we use Bare mode (direct) memory mapping as in lab1,
   // but now switch to paging mode in lab2.
   write_csr(satp, 0);
@@ -63,12 +90,31 @@ int s_start(void) {
   // now, switch to paging mode by turning on paging (SV39)
   enable_paging();
   sprint("kernel page table is on \n");
+  vdso_hart_init();
 
   init_proc_pool();
 
+  // select the scheduling policy (rr or mlfq)
+  sched_init();
+
+  // select the system call entry (fast path on unless syscall=slow)
+  syscall_init();
+
+  // find the floating point and vector units, whose state is switched lazily
+  fpu_init();
+
+  // start the timer wheel at the current time
+  timer_init();
+
   // init RAM Disk
   fs_init();
 
+  // let the other harts in, they block on the kernel lock until we leave the kernel.
+  kernel_lock();
+  g_cpu_online[0] = 1;
+  mb();
+  sboot_done = 1;
+
   // the application code (elf) is first loaded into memory, and then put into execution
   sprint("Switch to user mode...\n");
   insert_to_ready_queue( load_user_program() );
@@ -0,0 +1,178 @@
+/*
+ * the kernel log: a ring of binary records (the format string and its arguments) that any
+ * hart appends to without a lock. the text is made later, in batches: klog_drain prints the
+ * new records to the console with one host write, at the timer tick and when a hart goes
+ * idle, and the dmesg system call reads the whole ring.
+ */
+
+#include "klog.h"
+#include "riscv.h"
+#include "timer.h"
+#include "string.h"
+#include "util/snprintf.h"
+#include "spike_interface/atomic.h"
+#include "spike_interface/spike_utils.h"
+
+int g_klog_level = KLOG_LEVEL;
+int g_klog_console = KLOG_INFO;
+
+//
+// a record. seq is the ticket of the record plus one once it is complete, 0 while a writer
+// fills it in. a reader that finds another value lost the record to a newer one.
+//
+struct klog_rec {
+  uint64 seq;
+  uint64 time;
+  const char *fmt;
+  int level;
+  uint64 args[KLOG_MAXARGS];
+};
+
+static struct klog_rec klog_ring[KLOG_RING];
+// the next ticket to hand out, and the first record not printed to the console yet.
+static uint64 klog_head;
+static uint64 klog_console_tail;
+
+// the console output is collected here, and written to the host when full (console_write
+// passes a whole batch on in one piece).
+#define KLOG_BATCH 2048
+static char klog_batch[KLOG_BATCH];
+
+static int klog_parse_level(const char *key, int *level) {
+  static const char *names[] = { "err", "warn", "info", "debug" };
+  char val[16];
+
+  if (!bootarg_get(key, val, sizeof(val))) return 0;
+  for (int i = 0; i <= KLOG_DEBUG; i++)
+    if (strcmp(val, names[i]) == 0) *level = i;
+  if (val[0] >= '0' && val[0] <= '0' + KLOG_DEBUG && val[1] == '\0') *level = val[0] - '0';
+  return 1;
+}
+
+//
+// the boot arguments "loglevel=" and "console_loglevel=" take a name (err, warn, info,
+// debug) or a number. the console shows the records up to info by default.
+//
+void klog_init() {
+  klog_parse_level("loglevel", &g_klog_level);
+  klog_parse_level("console_loglevel", &g_klog_console);
+  if (g_klog_console > g_klog_level) g_klog_console = g_klog_level;
+}
+
+//
+// append a record, with the nargs (integer or pointer) arguments that follow. called through
+// the klog macro, which checks the levels first.
+//
+void klog_record(int level, const char *fmt, int nargs, ...) {
+  uint64 ticket = atomic_add(&klog_head, 1);
+  struct klog_rec *rec = &klog_ring[ticket % KLOG_RING];
+  va_list vl;
+
+  atomic_set(&rec->seq, 0);
+  asm volatile("fence w, w" ::: "memory");
+  rec->time = read_time();
+  rec->fmt = fmt;
+  rec->level = level;
+  va_start(vl, nargs);
+  for (int i = 0; i < nargs; i++) rec->args[i] = va_arg(vl, uint64);
+  va_end(vl);
+  asm volatile("fence w, w" ::: "memory");
+  atomic_set(&rec->seq, ticket + 1);
+}
+
+//
+// copy out record ticket. returns 1 if it is there, 0 if it is still being written, and -1
+// if it was overwritten already.
+//
+static int klog_get(uint64 ticket, struct klog_rec *out) {
+  struct klog_rec *rec = &klog_ring[ticket % KLOG_RING];
+  uint64 seq = atomic_read(&rec->seq);
+
+  if (seq != ticket + 1) {
+    // a newer record took the slot, or is being written to it.
+    if (seq > ticket + 1 || ticket + KLOG_RING < atomic_read(&klog_head)) return -1;
+    return 0;
+  }
+  asm volatile("fence r, r" ::: "memory");
+  *out = *rec;
+  asm volatile("fence r, r" ::: "memory");
+  return atomic_read(&rec->seq) == ticket + 1 ? 1 : -1;
+}
+
+//
+// the text of rec, with a "[seconds.microseconds] " prefix if stamp is set. the arguments
+// go in as 64-bit values, which the formatter reads back as int or long, as the format says:
+// every variadic argument takes a whole register (or stack slot) on RV64.
+//
+static int klog_format(struct klog_rec *rec, char *out, int len, int stamp) {
+  uint64 *a = rec->args;
+  int n = 0;
+
+  if (stamp) {
+    uint64 us = rec->time > g_boot_time ? time_to_ns(rec->time - g_boot_time) / 1000 : 0;
+    uint64 frac = us % 1000000;
+    // the formatter has no field widths: the microseconds are padded by hand.
+    char digits[7];
+    for (int i = 5; i >= 0; i--, frac /= 10) digits[i] = '0' + frac % 10;
+    digits[6] = '\0';
+    n = snprintf(out, len, "[%ld.%s] ", us / 1000000, digits);
+  }
+  if (n >= len) return len - 1;
+  n += snprintf(out + n, len - n, rec->fmt, a[0], a[1], a[2], a[3], a[4], a[5]);
+  return n < len ? n : len - 1;
+}
+
+//
+// print the records that came in since the last drain to the console, up to g_klog_console.
+// the text is collected in klog_batch, and written out with one host call for many records.
+// called with the kernel lock held.
+//
+void klog_drain() {
+  uint64 head = atomic_read(&klog_head);
+  struct klog_rec rec;
+  char line[256];
+  int n = 0;
+
+  if (klog_console_tail == head) return;
+  // records that were overwritten before the console got to them are lost.
+  if (head - klog_console_tail > KLOG_RING) klog_console_tail = head - KLOG_RING;
+
+  for (; klog_console_tail != head; klog_console_tail++) {
+    int r = klog_get(klog_console_tail, &rec);
+    if (r == 0) break;
+    if (r < 0 || rec.level > g_klog_console) continue;
+
+    int len = klog_format(&rec, line, sizeof(line), 0);
+    if (n + len > KLOG_BATCH) {
+      console_write(klog_batch, n);
+      n = 0;
+    }
+    memcpy(klog_batch + n, line, len);
+    n += len;
+  }
+  if (n) console_write(klog_batch, n);
+}
+
+//
+// the text of the records still in the ring, oldest first, with time stamps: whole lines,
+// as many as fit in buf (len bytes). returns the number of bytes.
+//
+int klog_read(char *buf, int len) {
+  uint64 head = atomic_read(&klog_head);
+  uint64 ticket = head > KLOG_RING ? head - KLOG_RING : 0;
+  struct klog_rec rec;
+  char line[256];
+  int n = 0;
+
+  for (; ticket != head; ticket++) {
+    int r = klog_get(ticket, &rec);
+    if (r == 0) break;
+    if (r < 0) continue;
+
+    int l = klog_format(&rec, line, sizeof(line), 1);
+    if (n + l > len) break;
+    memcpy(buf + n, line, l);
+    n += l;
+  }
+  return n;
+}
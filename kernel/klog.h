@@ -0,0 +1,52 @@
+#ifndef _KLOG_H_
+#define _KLOG_H_
+
+#include "util/types.h"
+
+// log levels, the most important first.
+#define KLOG_ERR 0
+#define KLOG_WARN 1
+#define KLOG_INFO 2
+#define KLOG_DEBUG 3
+
+// messages above KLOG_LEVEL are compiled out (make KLOG_LEVEL=n).
+#ifndef KLOG_LEVEL
+#define KLOG_LEVEL KLOG_DEBUG
+#endif
+
+// records kept in the ring (a power of two), arguments kept per record.
+#define KLOG_RING 512
+#define KLOG_MAXARGS 6
+
+// runtime levels: records above g_klog_level are not kept, records above g_klog_console are
+// kept for dmesg but not printed. set by the boot arguments loglevel= and console_loglevel=.
+extern int g_klog_level;
+extern int g_klog_console;
+
+void klog_init();
+void klog_record(int level, const char *fmt, int nargs, ...);
+void klog_drain();
+int klog_read(char *buf, int len);
+
+// number of the arguments after fmt, up to KLOG_MAXARGS.
+#define KLOG_NARGS(...) KLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define KLOG_NARGS_(z, a, b, c, d, e, f, n, ...) n
+
+//
+// log a message: only the format pointer and the arguments are stored, the text is
+// formatted when the ring is drained to the console (see klog_drain) or read by dmesg. so
+// the arguments are integers or pointers, and a %s argument has to be a string that is never
+// freed (a string literal, the name of a scheduler ...).
+//
+#define klog(level, fmt, ...)                                                   \
+  do {                                                                          \
+    if ((level) <= KLOG_LEVEL && (level) <= g_klog_level)                       \
+      klog_record(level, fmt, KLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__);          \
+  } while (0)
+
+#define klog_err(fmt, ...) klog(KLOG_ERR, fmt, ##__VA_ARGS__)
+#define klog_warn(fmt, ...) klog(KLOG_WARN, fmt, ##__VA_ARGS__)
+#define klog_info(fmt, ...) klog(KLOG_INFO, fmt, ##__VA_ARGS__)
+#define klog_debug(fmt, ...) klog(KLOG_DEBUG, fmt, ##__VA_ARGS__)
+
+#endif
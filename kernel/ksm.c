@@ -0,0 +1,167 @@
+/*
+ * same-page merging for anonymous user pages.
+ *
+ * a parent that forks many workers ends up with one private copy of every data page per
+ * worker (do_fork copies DATA segments). ksm_scan(), driven by the timer tick, hashes the
+ * writable pages of all live processes, and maps byte-identical pages to one shared frame.
+ * the shared frame is mapped read-only with PTE_COW set, so that the first write of a
+ * process gives it a private copy again (user_vm_cow_fault in vmm.c).
+ */
+
+#include "ksm.h"
+#include "riscv.h"
+#include "process.h"
+#include "vmm.h"
+#include "pmm.h"
+#include "util/string.h"
+#include "spike_interface/spike_utils.h"
+
+// process pool, defined in process.c
+extern process procs[NPROC];
+
+// the maximum number of distinct pages remembered in one scan
+#define KSM_MAX_PAGES 512
+#define KSM_HASH_SIZE 256
+
+// a page seen during the current scan
+typedef struct ksm_item_t {
+  uint64 hash;     // checksum of the page content
+  uint64 pa;       // frame the page is mapped to
+  pte_t *pte;      // a PTE mapping the frame
+  int next;        // next item in the same hash bucket, -1 terminates
+} ksm_item;
+
+static ksm_item ksm_items[KSM_MAX_PAGES];
+static int ksm_buckets[KSM_HASH_SIZE];
+static int ksm_nitems;
+
+ksm_stat_t ksm_stat;
+
+//
+// FNV-1a checksum of a page, taken 64 bits at a time.
+//
+static uint64 page_hash(uint64 pa) {
+  uint64 *w = (uint64 *)pa;
+  uint64 h = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < PGSIZE / sizeof(uint64); i++) h = (h ^ w[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+//
+// returns 1 if va belongs to a code segment of proc, or to a page the kernel accesses by
+// its physical address (SHARED_SEGMENT, VDSO_SEGMENT). code pages are shared by do_fork without reference
+// counting, and neither must ever be merged.
+//
+static int in_unmergeable_segment(process *proc, uint64 va) {
+  for (int i = 0; i < proc->total_mapped_region; i++) {
+    mapped_region *r = &proc->mapped_info[i];
+    if ((r->seg_type == CODE_SEGMENT || r->seg_type == SHARED_SEGMENT ||
+         r->seg_type == VDSO_SEGMENT) &&
+        va >= r->va && va < r->va + r->npages * PGSIZE)
+      return 1;
+  }
+  return 0;
+}
+
+//
+// candidate pages: anonymous (data, stack, heap) pages that are writable or already merged,
+// and that were not written since the last aging scan (a page that is being written now
+// would be un-merged again right away).
+//
+static int ksm_candidate(process *proc, pte_t pte, uint64 va) {
+  if ((pte & (PTE_W | PTE_COW)) == 0) return 0;
+  if ((pte & PTE_D) && !(pte & PTE_COW)) return 0;
+  return !in_unmergeable_segment(proc, va);
+}
+
+//
+// map *pte to the shared frame of item, and release the frame *pte pointed to before.
+//
+static void ksm_merge(process *owner, pte_t *pte, ksm_item *item) {
+  uint64 old = PTE2PA(*pte);
+
+  // the first mapping of the frame becomes read-only too.
+  if ((*item->pte & PTE_COW) == 0) *item->pte = (*item->pte & ~(PTE_W | PTE_D)) | PTE_COW;
+
+  page_ref_inc((void *)item->pa);
+  *pte = PA2PTE(item->pa) | (PTE_FLAGS(*pte) & ~(PTE_W | PTE_D)) | PTE_COW;
+  tlb_mark_stale();
+
+  free_page((void *)old);
+  // free_page() credits the running process, while the page belonged to owner.
+  if (page_ref_count((void *)old) == 0) {
+    if (current) ++current->total_mem_count;
+    --owner->total_mem_count;
+  }
+  ksm_stat.merges++;
+}
+
+//
+// visit one user page of a process during the merge pass.
+//
+static void ksm_visit(pte_t *pte, uint64 va, void *arg) {
+  process *proc = (process *)arg;
+  if (!ksm_candidate(proc, *pte, va)) return;
+
+  uint64 pa = PTE2PA(*pte);
+  uint64 hash = page_hash(pa);
+  int b = hash % KSM_HASH_SIZE;
+
+  for (int i = ksm_buckets[b]; i >= 0; i = ksm_items[i].next) {
+    ksm_item *item = &ksm_items[i];
+    if (item->hash != hash) continue;
+    if (item->pa == pa) return;  // already shares this frame
+    if (memcmp((void *)item->pa, (void *)pa, PGSIZE) == 0) {
+      ksm_merge(proc, pte, item);
+      return;
+    }
+  }
+
+  // first page with this content in the current scan, remember it.
+  if (ksm_nitems >= KSM_MAX_PAGES) return;
+  ksm_items[ksm_nitems].hash = hash;
+  ksm_items[ksm_nitems].pa = pa;
+  ksm_items[ksm_nitems].pte = pte;
+  ksm_items[ksm_nitems].next = ksm_buckets[b];
+  ksm_buckets[b] = ksm_nitems++;
+}
+
+//
+// visit one user page of a process during the counting pass.
+//
+static void ksm_count(pte_t *pte, uint64 va, void *arg) {
+  process *proc = (process *)arg;
+  if (!ksm_candidate(proc, *pte, va)) return;
+
+  if (page_ref_count((void *)PTE2PA(*pte)) > 1)
+    ksm_stat.merged++;
+  else
+    ksm_stat.unmerged++;
+}
+
+//
+// same-page merging scan, called from the timer tick every KSM_SCAN_INTERVAL ticks.
+// every scan starts with an empty table. pages merged by earlier scans are found again
+// through their frame, so later copies of the same content join the existing frame.
+//
+void ksm_scan() {
+  memset(ksm_buckets, 0xff, sizeof(ksm_buckets));
+  ksm_nitems = 0;
+
+  for (int i = 0; i < NPROC; i++) {
+    if (procs[i].status == FREE || procs[i].status == ZOMBIE) continue;
+    // a process running on another hart may write a page between the compare and the
+    // merge, leave it for a later scan. so may a vfork child, on the pages of its parent.
+    if (procs[i].status == RUNNING && &procs[i] != current) continue;
+    if (procs[i].vfork_parent || procs[i].vfork_child) continue;
+    user_vm_walk(procs[i].pagetable, ksm_visit, &procs[i]);
+  }
+
+  ksm_stat.merged = ksm_stat.unmerged = ksm_stat.shared = 0;
+  for (int i = 0; i < NPROC; i++) {
+    if (procs[i].status == FREE || procs[i].status == ZOMBIE || procs[i].vfork_parent) continue;
+    user_vm_walk(procs[i].pagetable, ksm_count, &procs[i]);
+  }
+  for (int i = 0; i < ksm_nitems; i++)
+    if (page_ref_count((void *)ksm_items[i].pa) > 1) ksm_stat.shared++;
+}
@@ -0,0 +1,22 @@
+#ifndef _KSM_H_
+#define _KSM_H_
+
+#include "util/types.h"
+
+// statistics of same-page merging
+typedef struct ksm_stat_t {
+  // results of the last scan
+  int merged;     // candidate pages that map a shared (merged) frame
+  int unmerged;   // candidate pages that still map a private frame
+  int shared;     // shared frames backing the merged pages
+  // running totals
+  uint64 merges;      // pages merged into a shared frame
+  uint64 cow_breaks;  // writes that un-merged a page again
+} ksm_stat_t;
+
+extern ksm_stat_t ksm_stat;
+
+// scan the anonymous pages of all live processes and merge identical ones
+void ksm_scan();
+
+#endif
@@ -5,6 +5,7 @@
 #include "util/types.h"
 #include "kernel/riscv.h"
 #include "kernel/config.h"
+#include "kernel/smp.h"
 #include "spike_interface/spike_utils.h"
 
 //
@@ -23,8 +24,11 @@ extern void mtrapvec();
 extern uint64 htif;
 // g_mem_size is defined in kernel/machine/spike_memory.c, size of the emulated memory
 extern uint64 g_mem_size;
-// g_itrframe is used for saving registers when interrupt hapens in M mode
-struct riscv_regs g_itrframe;
+// g_itrframe is used for saving registers when interrupt hapens in M mode, one per hart
+struct riscv_regs g_itrframe[NCPU];
+
+// set by hart 0 once HTIF and the memory size are known, the other harts wait for it
+static volatile int mboot_done = 0;
 
 //
 // get the information of HTIF (calling interface) and the emulated memory by
@@ -42,6 +46,14 @@ void init_dtb(uint64 dtb) {
   // defined in kernel/machine/fdt.c, obtain information about emulated memory
   query_mem(dtb);
   sprint("(Emulated) memory size: %ld MB\n", g_mem_size >> 20);
+
+  // defined in spike_interface/spike_bootargs.c, obtain the kernel command line
+  query_bootargs(dtb);
+
+  // defined in spike_interface/spike_cpu.c, obtain the frequency of the timer (mtime)
+  query_cpus(dtb);
+  sprint("Timebase frequency: %ld Hz\n", g_timebase);
+  sprint("Timer: %s\n", g_sstc ? "stimecmp (Sstc)" : "mtimecmp");
 }
 
 //
@@ -70,6 +82,18 @@ static void delegate_traps() {
 // enabling timer interrupt (irq) in Machine mode
 //
 void timerinit(uintptr_t hartid) {
+  // the software irq carries the IPIs between harts (see kernel/smp.c).
+  write_csr(mie, read_csr(mie) | MIE_MSIE);
+
+  if (g_sstc) {
+    // with Sstc, S-mode programs its own timer (stimecmp), and the (delegated) supervisor
+    // timer irq goes to S-mode directly. the machine timer stays off.
+    *(uint64*)CLINT_MTIMECMP(hartid) = -1;
+    set_menvcfg(MENVCFG_STCE);
+    write_stimecmp(*(uint64*)CLINT_MTIME + TIMER_INTERVAL);
+    return;
+  }
+
   // fire timer irq after TIMER_INTERVAL from now.
   *(uint64*)CLINT_MTIMECMP(hartid) = *(uint64*)CLINT_MTIME + TIMER_INTERVAL;
 
@@ -81,15 +105,28 @@ void timerinit(uintptr_t hartid) {
 // m_start: machine mode C entry point.
 //
 void m_start(uintptr_t hartid, uintptr_t dtb) {
-  // init the spike file interface (stdin,stdout,stderr)
-  spike_file_init();
-  sprint("In m_start, hartid:%d\n", hartid);
-
-  // init HTIF (Host-Target InterFace) and memory by using the Device Table Blob (DTB)
-  init_dtb(dtb);
+  // the hartid stays in tp, for the S-mode kernel (see kernel/smp.h), and for the console
+  // buffers (see console_write), which are used from here on.
+  write_tp(hartid);
+
+  if (hartid == 0) {
+    // init the spike file interface (stdin,stdout,stderr)
+    spike_file_init();
+    sprint("In m_start, hartid:%d\n", hartid);
+
+    // init HTIF (Host-Target InterFace) and memory by using the Device Table Blob (DTB)
+    init_dtb(dtb);
+
+    mb();
+    mboot_done = 1;
+  } else {
+    while (!mboot_done)
+      ;
+    sprint("In m_start, hartid:%d\n", hartid);
+  }
 
   // save the address of frame for interrupt in M mode to csr "mscratch".
-  write_csr(mscratch, &g_itrframe);
+  write_csr(mscratch, &g_itrframe[hartid]);
 
   // set previous privilege mode to S (Supervisor), and will enter S mode after 'mret'
   write_csr(mstatus, ((read_csr(mstatus) & ~MSTATUS_MPP_MASK) | MSTATUS_MPP_S));
@@ -103,6 +140,9 @@ void m_start(uintptr_t hartid, uintptr_t dtb) {
   // enable machine-mode interrupts.
   write_csr(mstatus, read_csr(mstatus) | MSTATUS_MIE);
 
+  // let supervisor mode read the time and cycle counters (rdtime/rdcycle).
+  write_csr(mcounteren, -1);
+
   // delegate all interrupts and exceptions to supervisor mode.
   delegate_traps();
   write_csr(sie, read_csr(sie) | SIE_SEIE | SIE_STIE | SIE_SSIE);
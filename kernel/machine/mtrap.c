@@ -1,5 +1,6 @@
 #include "kernel/riscv.h"
 #include "kernel/process.h"
+#include "kernel/smp.h"
 #include "spike_interface/spike_utils.h"
 
 static void handle_instruction_access_fault() { panic("Instruction access fault!"); }
@@ -15,11 +16,23 @@ static void handle_misaligned_load() { panic("Misaligned Load!"); }
 static void handle_misaligned_store() { panic("Misaligned AMO!"); }
 
 static void handle_timer() {
-  int cpuid = 0;
-  // setup the timer fired at next time (TIMER_INTERVAL from now)
-  *(uint64*)CLINT_MTIMECMP(cpuid) = *(uint64*)CLINT_MTIMECMP(cpuid) + TIMER_INTERVAL;
+  int hartid = read_csr(mhartid);
+  // turn the timer off. S-mode sets the next one before it leaves the kernel (see
+  // sched_program_timer), for its next tick or kernel timer only.
+  *(uint64*)CLINT_MTIMECMP(hartid) = -1;
 
   // setup a soft interrupt in sip (S-mode Interrupt Pending) to be handled in S-mode
+  atomic_or(&g_ipi_pending[hartid], IPI_TIMER);
+  write_csr(sip, SIP_SSIP);
+}
+
+//
+// an IPI from another hart (see kernel/smp.c), its reasons are already posted in
+// g_ipi_pending. pass it on to S-mode.
+//
+static void handle_ipi() {
+  int hartid = read_csr(mhartid);
+  *(volatile uint32*)CLINT_MSIP(hartid) = 0;
   write_csr(sip, SIP_SSIP);
 }
 
@@ -32,6 +45,9 @@ void handle_mtrap() {
     case CAUSE_MTIMER:
       handle_timer();
       break;
+    case CAUSE_MSOFT:
+      handle_ipi();
+      break;
     case CAUSE_FETCH_ACCESS:
       handle_instruction_access_fault();
       break;
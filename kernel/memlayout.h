@@ -1,6 +1,7 @@
 #ifndef _MEMLAYOUT_H
 #define _MEMLAYOUT_H
 #include "riscv.h"
+#include "config.h"
 
 // RISC-V machine places its physical memory above DRAM_BASE
 #define DRAM_BASE 0x80000000
@@ -14,7 +15,18 @@
 // virtual address of stack top of user process
 #define USER_STACK_TOP 0x7ffff000
 
+// virtual address of the CLINT for the kernel, right after the direct map: the CLINT itself
+// lies in the first gigabyte, among the user mappings.
+#define KERN_CLINT PHYS_TOP
+#define KERN_CLINT_MSIP(hartid) (KERN_CLINT + CLINT_MSIP(hartid) - CLINT)
+#define KERN_CLINT_MTIMECMP(hartid) (KERN_CLINT + CLINT_MTIMECMP(hartid) - CLINT)
+
 // simple heap bottom, virtual address starts from 4MB
 #define USER_FREE_ADDRESS_START 0x00000000 + PGSIZE * 1024
 
+// virtual address of the submission/completion ring page of a process (see uring.c)
+#define URING_VA 0x70000000
+
+// the kernel data page of every process follows at VDSO_VA (see vdso.h)
+
 #endif
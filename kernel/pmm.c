@@ -23,6 +23,12 @@ typedef struct node {
 // g_free_mem_list is the head of the list of free physical memory pages
 static list_node g_free_mem_list;
 
+// reference counts of allocated physical pages, indexed by page frame number (from
+// DRAM_BASE). a page merged by the same-page merging scanner (ksm.c) is referenced by
+// several PTEs, and is only returned to g_free_mem_list when the last one goes away.
+static uint16 page_refs[PKE_MAX_ALLOWABLE_RAM / PGSIZE];
+#define PAGE_REF(pa) (page_refs[((uint64)(pa) - DRAM_BASE) / PGSIZE])
+
 //
 // actually creates the freepage list. each page occupies 4KB (PGSIZE)
 //
@@ -39,6 +45,13 @@ void free_page(void *pa) {
   if (((uint64)pa % PGSIZE) != 0 || (uint64)pa < free_mem_start_addr || (uint64)pa >= free_mem_end_addr)
     panic("free_page 0x%lx \n", pa);
 
+  // a shared page stays allocated until its last reference is dropped.
+  if (PAGE_REF(pa) > 1) {
+    --PAGE_REF(pa);
+    return;
+  }
+  PAGE_REF(pa) = 0;
+
   // insert a physical page to g_free_mem_list
   list_node *n = (list_node *)pa;
   n->next = g_free_mem_list.next;
@@ -53,12 +66,30 @@ void free_page(void *pa) {
 //
 void *alloc_page(void) {
   list_node *n = g_free_mem_list.next;
-  if (n) g_free_mem_list.next = n->next;
+  if (n) {
+    g_free_mem_list.next = n->next;
+    PAGE_REF(n) = 1;
+  }
   if ( current != NULL )
     ++ current->total_mem_count;
   return (void *)n;
 }
 
+//
+// take one more reference to an allocated page.
+//
+void page_ref_inc(void *pa) {
+  if (PAGE_REF(pa) == 0) panic("page_ref_inc: page 0x%lx is not allocated\n", pa);
+  ++PAGE_REF(pa);
+}
+
+//
+// returns the number of references to an allocated page.
+//
+int page_ref_count(void *pa) {
+  return PAGE_REF(pa);
+}
+
 //
 // pmm_init() establishes the list of free physical pages according to available
 // physical memory space.
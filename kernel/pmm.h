@@ -5,7 +5,11 @@
 void pmm_init();
 // Allocate a free phisical page
 void* alloc_page();
-// Free an allocated page
+// Free an allocated page (drops one reference of a shared page)
 void free_page(void* pa);
+// Take one more reference to an allocated page
+void page_ref_inc(void* pa);
+// Number of references to an allocated page
+int page_ref_count(void* pa);
 
 #endif
\ No newline at end of file
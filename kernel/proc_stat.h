@@ -0,0 +1,33 @@
+#ifndef _PROC_STAT_H_
+#define _PROC_STAT_H_
+
+#include "util/types.h"
+
+//
+// cpu accounting of a process, as returned by the getstat system call. times are in
+// nanoseconds, cycles are counted by rdcycle on the harts the process ran on.
+//
+struct proc_stat {
+  uint64 utime;    // time spent in user mode
+  uint64 stime;    // time spent in the kernel on behalf of the process
+  uint64 wtime;    // time spent ready in a run queue, waiting for a hart
+  uint64 ucycles;  // cycles spent in user mode
+  uint64 scycles;  // cycles spent in the kernel
+  uint64 nvcsw;    // voluntary context switches (yield, blocking)
+  uint64 nivcsw;   // involuntary context switches (preemption)
+  uint64 dl_misses;  // deadline misses of a deadline (edf) process
+};
+
+//
+// usage of a cpu group, as returned by the group_stat system call. times in nanoseconds.
+//
+struct group_stat {
+  uint64 quota;         // processor time per period, 0 if unlimited
+  uint64 period;
+  uint64 usage;         // processor time used by the processes of the group
+  uint64 throttled;     // time spent throttled
+  uint64 nr_throttled;  // periods in which the group was throttled
+  uint64 nr_procs;      // live processes in the group
+};
+
+#endif
@@ -17,11 +17,15 @@
 #include "memlayout.h"
 #include "sched.h"
 #include "file.h"
+#include "ksm.h"
+#include "group.h"
+#include "fpu.h"
+#include "klog.h"
 #include "spike_interface/spike_utils.h"
 
 //Two functions defined in kernel/usertrap.S
 extern char smode_trap_vector[];
-extern void return_to_user(trapframe *, uint64 satp);
+extern void return_to_user(trapframe *, uint64 satp, ticketlock_t *kernel_lock);
 
 //
 // trap_sec_start points to the beginning of S-mode trap segment (i.e., the entry point
@@ -36,8 +40,8 @@ extern uint64 g_ticks;
 // (emulated) spike machine.
 extern uint64 g_mem_size;
 
-// current points to the currently running user-mode application.
-process* current = NULL;
+// g_current[i] points to the user-mode application running on hart i.
+process* g_current[NCPU];
 
 // process pool
 process procs[NPROC];
@@ -53,11 +57,15 @@ void switch_to(process* proc) {
   current = proc;
 
   write_csr(stvec, (uint64)smode_trap_vector);
+  // the floating point and vector units stay on only if they hold the state of proc.
+  fpu_switch(proc);
   // set up trapframe values that smode_trap_vector will need when
   // the process next re-enters the kernel.
   proc->trapframe->kernel_sp = proc->kstack;      // process's kernel stack
-  proc->trapframe->kernel_satp = read_csr(satp);  // kernel page table
+  // kernel page table, 0 to stay on the user page table (see strap_vector.S)
+  proc->trapframe->kernel_satp = g_kmap_shared ? 0 : MAKE_SATP(g_kernel_pagetable);
   proc->trapframe->kernel_trap = (uint64)smode_trap_handler;
+  proc->trapframe->kernel_hartid = cpuid();
 
   // set up the registers that strap_vector.S's sret will use
   // to get to user space.
@@ -72,11 +80,63 @@ void switch_to(process* proc) {
   // set S Exception Program Counter to the saved user pc.
   write_csr(sepc, proc->trapframe->epc);
 
+  uint64 user_satp = prepare_return(proc);
+
+  // switch to user mode with sret. return_to_user releases the kernel lock once it no
+  // longer needs the kernel stack, which another hart may use right after.
+  return_to_user(proc->trapframe, user_satp, &g_kernel_lock);
+}
+
+//
+// the last steps before proc (the current process) goes back to user mode, shared by
+// switch_to and the fast system call path. returns the user page table for satp, or 0 if
+// the hart can stay on the page table it runs on.
+//
+uint64 prepare_return(process* proc) {
   //make user page table
   uint64 user_satp = MAKE_SATP(proc->pagetable);
+  // with shared kernel mappings, a process that goes back to user mode on the page table it
+  // trapped on keeps it, unless its tlb entries are stale.
+  if (g_kmap_shared && read_csr(satp) == user_satp && !g_tlb_stale[cpuid()])
+    user_satp = 0;
+  else
+    g_tlb_stale[cpuid()] = 0;
+
+  // set the timer for the next tick, or the next kernel timer (tickless).
+  sched_program_timer();
+  acct_user_return(proc);
+  vdso_update(proc);
+
+  g_cpu_in_user[cpuid()] = 1;
+  return user_satp;
+}
 
-  // switch to user mode with sret.
-  return_to_user(proc->trapframe, user_satp);
+//
+// map what the trap vector needs into the page table of proc: its trapframe, and the trap
+// vector section (direct mapping as in kernel space). with shared kernel mappings (see
+// user_vm_share_kernel) both are mapped already, and the segments are recorded without
+// pages.
+//
+static void map_kernel_for_user(process* proc) {
+  int npages = g_kmap_shared ? 0 : 1;
+
+  if (g_kmap_shared) {
+    user_vm_share_kernel(proc->pagetable);
+  } else {
+    user_vm_map((pagetable_t)proc->pagetable, (uint64)proc->trapframe, PGSIZE,
+      (uint64)proc->trapframe, prot_to_type(PROT_WRITE | PROT_READ, 0));
+    // we assume that the size of usertrap.S is smaller than a page.
+    user_vm_map((pagetable_t)proc->pagetable, (uint64)trap_sec_start, PGSIZE,
+      (uint64)trap_sec_start, prot_to_type(PROT_READ | PROT_EXEC, 0));
+  }
+
+  proc->mapped_info[1].va = (uint64)proc->trapframe;
+  proc->mapped_info[1].npages = npages;
+  proc->mapped_info[1].seg_type = CONTEXT_SEGMENT;
+
+  proc->mapped_info[2].va = (uint64)trap_sec_start;
+  proc->mapped_info[2].npages = npages;
+  proc->mapped_info[2].seg_type = SYSTEM_SEGMENT;
 }
 
 //
@@ -91,13 +151,48 @@ void init_proc_pool() {
     procs[i].tick_count = 0;
     procs[i].total_tick_count = 0;
     procs[i].total_mem_count = 0;
+    procs[i].priority = DEFAULT_PRIO;
+    procs[i].on_queue = 0;
+    procs[i].nice = 0;
+    procs[i].weight = NICE_0_WEIGHT;
+    procs[i].heap_index = -1;
   }
 }
 
 //
-// allocate an empty process, init its vm space. returns its pid
+// give proc a new address space: a page directory with the user stack, the pages of the
+// trap vector and the kernel data page. proc->mapped_info is cleared to record them.
 //
-process* alloc_process() {
+static void alloc_vm_space(process* proc) {
+  // page directory
+  proc->pagetable = (pagetable_t)alloc_page();
+  memset((void *)proc->pagetable, 0, PGSIZE);
+
+  uint64 user_stack = (uint64)alloc_page();       //phisical address of user stack bottom
+  proc->trapframe->regs.sp = USER_STACK_TOP;  //virtual address of user stack top
+
+  memset( proc->mapped_info, 0, PGSIZE );
+
+  // map user stack in userspace
+  user_vm_map((pagetable_t)proc->pagetable, USER_STACK_TOP - PGSIZE, PGSIZE,
+    user_stack, prot_to_type(PROT_WRITE | PROT_READ, 1));
+  proc->mapped_info[0].va = USER_STACK_TOP - PGSIZE;
+  proc->mapped_info[0].npages = 1;
+  proc->mapped_info[0].seg_type = STACK_SEGMENT;
+
+  map_kernel_for_user(proc);
+  vdso_map(proc);
+
+  klog_debug("in alloc_proc. user frame 0x%lx, user stack 0x%lx, user kstack 0x%lx \n",
+    proc->trapframe, proc->trapframe->regs.sp, proc->kstack);
+
+  proc->total_mapped_region = 4;
+}
+
+//
+// allocate an empty process, without an address space: its kernel stack and trapframe.
+//
+static process* alloc_process_struct() {
   // locate the first usable process structure
   int i;
 
@@ -110,59 +205,79 @@ process* alloc_process() {
   }
 
   procs[i].total_mem_count = 0;
+  procs[i].priority = DEFAULT_PRIO;
+  procs[i].on_queue = 0;
+  procs[i].cpu = cpuid();
+  procs[i].waiting_on = NULL;
+  procs[i].wait_child.head = procs[i].wait_child.tail = NULL;
+  procs[i].vfork_parent = procs[i].vfork_child = NULL;
+  procs[i].vfork_wait.head = procs[i].vfork_wait.tail = NULL;
+  procs[i].nice = 0;
+  procs[i].weight = NICE_0_WEIGHT;
+  procs[i].vruntime = 0;
+  procs[i].heap_index = -1;
+  procs[i].sum_exec_runtime = 0;
+  procs[i].utime = procs[i].stime = procs[i].wait_time = 0;
+  procs[i].ucycles = procs[i].scycles = 0;
+  procs[i].nvcsw = procs[i].nivcsw = 0;
+  procs[i].dl_runtime = procs[i].dl_deadline = procs[i].dl_period = 0;
+  procs[i].dl_throttled = 0;
+  procs[i].dl_misses = 0;
+  procs[i].group = NULL;
+  group_attach(&procs[i], &cpu_groups[0]);
+  procs[i].uring = NULL;
+  fpu_reset(&procs[i]);
+#ifdef SYSCALL_STATS
+  procs[i].syscall_stats = (struct syscall_stat *)alloc_page();
+  memset(procs[i].syscall_stats, 0, PGSIZE);
+#endif
 
-  // init proc[i]'s vm space
   procs[i].trapframe = (trapframe *)alloc_page();  //trapframe, used to save context
   memset(procs[i].trapframe, 0, sizeof(trapframe));
-
-  // page directory
-  procs[i].pagetable = (pagetable_t)alloc_page();
-  memset((void *)procs[i].pagetable, 0, PGSIZE);
-
   procs[i].kstack = (uint64)alloc_page() + PGSIZE;   //user kernel stack top
-  uint64 user_stack = (uint64)alloc_page();       //phisical address of user stack bottom
-  procs[i].trapframe->regs.sp = USER_STACK_TOP;  //virtual address of user stack top
-
-  // allocates a page to record memory regions (segments)
-  procs[i].mapped_info = (mapped_region*)alloc_page();
-  memset( procs[i].mapped_info, 0, PGSIZE );
-
-  // map user stack in userspace
-  user_vm_map((pagetable_t)procs[i].pagetable, USER_STACK_TOP - PGSIZE, PGSIZE,
-    user_stack, prot_to_type(PROT_WRITE | PROT_READ, 1));
-  procs[i].mapped_info[0].va = USER_STACK_TOP - PGSIZE;
-  procs[i].mapped_info[0].npages = 1;
-  procs[i].mapped_info[0].seg_type = STACK_SEGMENT;
-
-  // map trapframe in user space (direct mapping as in kernel space).
-  user_vm_map((pagetable_t)procs[i].pagetable, (uint64)procs[i].trapframe, PGSIZE,
-    (uint64)procs[i].trapframe, prot_to_type(PROT_WRITE | PROT_READ, 0));
-  procs[i].mapped_info[1].va = (uint64)procs[i].trapframe;
-  procs[i].mapped_info[1].npages = 1;
-  procs[i].mapped_info[1].seg_type = CONTEXT_SEGMENT;
-
-  // map S-mode trap vector section in user space (direct mapping as in kernel space)
-  // we assume that the size of usertrap.S is smaller than a page.
-  user_vm_map((pagetable_t)procs[i].pagetable, (uint64)trap_sec_start, PGSIZE,
-    (uint64)trap_sec_start, prot_to_type(PROT_READ | PROT_EXEC, 0));
-  procs[i].mapped_info[2].va = (uint64)trap_sec_start;
-  procs[i].mapped_info[2].npages = 1;
-  procs[i].mapped_info[2].seg_type = SYSTEM_SEGMENT;
-
-  sprint("in alloc_proc. user frame 0x%lx, user stack 0x%lx, user kstack 0x%lx \n",
-    procs[i].trapframe, procs[i].trapframe->regs.sp, procs[i].kstack);
-
-  procs[i].total_mapped_region = 3;
 
   procs[i].total_tick_count = 0;
   procs[i].tick_count = 0;
+  procs[i].wss_pages = procs[i].wss_dirty = procs[i].idle_pages = 0;
+
+  return &procs[i];
+}
+
+//
+// allocate an empty process, init its vm space. returns its pid
+//
+process* alloc_process() {
+  process* proc = alloc_process_struct();
+
+  // allocates a page to record memory regions (segments)
+  proc->mapped_info = (mapped_region*)alloc_page();
+  alloc_vm_space(proc);
 
   // initialize files_struct
-  procs[i].pfiles = files_create();
-  sprint("in alloc_proc. build files_struct successfully.\n");
+  proc->pfiles = files_create();
+  klog_debug("in alloc_proc. build files_struct successfully.\n");
   
   // return after initialization.
-  return &procs[i];
+  return proc;
+}
+
+//
+// a vfork child gives the address space back to its parent, at exec or exit: the parent
+// runs again. the child is left without an address space (pagetable NULL) until exec
+// gives it one.
+//
+static void vfork_release( process* child ) {
+  process* parent = child->vfork_parent;
+  if( !parent ) return;
+
+  if( !g_kmap_shared )
+    user_vm_unmap( parent->pagetable, (uint64)child->trapframe, PGSIZE, 0 );
+  child->pagetable = NULL;
+  child->mapped_info = NULL;
+  child->total_mapped_region = 0;
+  child->vdso = NULL;
+  child->vfork_parent = NULL;
+  wakeup( &parent->vfork_wait );
 }
 
 //
@@ -174,6 +289,14 @@ int free_process( process* proc ) {
   // but for proxy kernel, it (memory leaking) may NOT be a really serious issue,
   // as it is different from regular OS, which needs to run 7x24.
   proc->status = ZOMBIE;
+  vfork_release( proc );
+  // give the bandwidth of a deadline process back.
+  sched_setdeadline( proc, 0, 0, 0 );
+  group_detach( proc );
+  fpu_reset( proc );
+
+  // a parent blocked in wait() can reap it now.
+  if ( proc->parent ) wakeup( &proc->parent->wait_child );
 
   return 0;
 }
@@ -182,17 +305,22 @@ int free_process( process* proc ) {
 // reallocate a process
 // 
 void realloc_process(int i) {
+  // a vfork child leaves the address space of its parent alone.
+  vfork_release(&procs[i]);
+
   // 1. free procs[i]
   for( int j=0; j<procs[i].total_mapped_region; ++ j ){
     switch( procs[i].mapped_info[j].seg_type ){
       case STACK_SEGMENT:   // free user stack
-      case CONTEXT_SEGMENT: // free trapframe
       case DATA_SEGMENT:    // free data segment
+      case SHARED_SEGMENT:  // free the uring page
+      case VDSO_SEGMENT:    // free the kernel data page
         user_vm_unmap(procs[i].pagetable, 
                       procs[i].mapped_info[j].va, 
                       procs[i].mapped_info[j].npages*PGSIZE, 
                       1);   // 取消映射并释放物理页
         break;
+      case CONTEXT_SEGMENT: // the trapframe is kept, see below
       case CODE_SEGMENT:
         user_vm_unmap(procs[i].pagetable, 
                       procs[i].mapped_info[j].va,
@@ -201,54 +329,20 @@ void realloc_process(int i) {
         break;
     }
   }
-  free_page(procs[i].pagetable);
+  if (procs[i].pagetable) free_page(procs[i].pagetable);
+  else procs[i].mapped_info = (mapped_region*)alloc_page();
+  procs[i].uring = NULL;
+  fpu_reset(&procs[i]);
 
   // 2. alloc proc[i]
-  // init proc[i]'s vm space
-  procs[i].trapframe = (trapframe *)alloc_page();  //trapframe, used to save context
+  // init proc[i]'s vm space. the trapframe page stays the same: the exec system call that
+  // got here returns through it (see handle_syscall).
   memset(procs[i].trapframe, 0, sizeof(trapframe));
+  alloc_vm_space(&procs[i]);
 
-  // page directory
-  procs[i].pagetable = (pagetable_t)alloc_page();
-  memset((void *)procs[i].pagetable, 0, PGSIZE);
-
-  // procs[i].kstack = (uint64)alloc_page() + PGSIZE;   //user kernel stack top
-  uint64 user_stack = (uint64)alloc_page();       //phisical address of user stack bottom
-  procs[i].trapframe->regs.sp = USER_STACK_TOP;  //virtual address of user stack top
-
-  // allocates a page to record memory regions (segments)
-  // procs[i].mapped_info = (mapped_region*)alloc_page();
-  memset( procs[i].mapped_info, 0, PGSIZE );
-
-  // map user stack in userspace
-  user_vm_map((pagetable_t)procs[i].pagetable, USER_STACK_TOP - PGSIZE, PGSIZE,
-    user_stack, prot_to_type(PROT_WRITE | PROT_READ, 1));
-  procs[i].mapped_info[0].va = USER_STACK_TOP - PGSIZE;
-  procs[i].mapped_info[0].npages = 1;
-  procs[i].mapped_info[0].seg_type = STACK_SEGMENT;
-
-  // map trapframe in user space (direct mapping as in kernel space).
-  user_vm_map((pagetable_t)procs[i].pagetable, (uint64)procs[i].trapframe, PGSIZE,
-    (uint64)procs[i].trapframe, prot_to_type(PROT_WRITE | PROT_READ, 0));
-  procs[i].mapped_info[1].va = (uint64)procs[i].trapframe;
-  procs[i].mapped_info[1].npages = 1;
-  procs[i].mapped_info[1].seg_type = CONTEXT_SEGMENT;
-
-  // map S-mode trap vector section in user space (direct mapping as in kernel space)
-  // we assume that the size of usertrap.S is smaller than a page.
-  user_vm_map((pagetable_t)procs[i].pagetable, (uint64)trap_sec_start, PGSIZE,
-    (uint64)trap_sec_start, prot_to_type(PROT_READ | PROT_EXEC, 0));
-  procs[i].mapped_info[2].va = (uint64)trap_sec_start;
-  procs[i].mapped_info[2].npages = 1;
-  procs[i].mapped_info[2].seg_type = SYSTEM_SEGMENT;
-
-  sprint("in alloc_proc. user frame 0x%lx, user stack 0x%lx, user kstack 0x%lx \n",
-    procs[i].trapframe, procs[i].trapframe->regs.sp, procs[i].kstack);
-
-  procs[i].total_mapped_region = 3;
   procs[i].tick_count = 0;
   procs[i].total_tick_count = 0;
-  procs[i].total_mem_count = 3;
+  procs[i].total_mem_count = 4;
   return;
 }
 
@@ -261,7 +355,7 @@ void realloc_process(int i) {
 //
 int do_fork( process* parent)
 {
-  sprint( "will fork a child from parent %d.\n", parent->pid );
+  klog_debug( "will fork a child from parent %d.\n", parent->pid );
   process* child = alloc_process();
 
   for( int i=0; i<parent->total_mapped_region; i++ ){
@@ -282,7 +376,7 @@ int do_fork( process* parent)
           map_pages(child->pagetable, parent->mapped_info[i].va+j*PGSIZE, PGSIZE,
             addr, prot_to_type(PROT_WRITE | PROT_READ | PROT_EXEC, 1));
 
-          sprint( "do_fork map code segment at pa:%lx of parent to child at va:%lx.\n",
+          klog_debug( "do_fork map code segment at pa:%lx of parent to child at va:%lx.\n",
             addr, parent->mapped_info[i].va+j*PGSIZE );
         }
         // after mapping, register the vm region (do not delete codes below!)
@@ -313,12 +407,28 @@ int do_fork( process* parent)
         child->mapped_info[child->total_mapped_region].seg_type = DATA_SEGMENT;
         ++ child->total_mapped_region;
         break;
+      case SHARED_SEGMENT: {
+        // the child gets rings of its own, with the state of the parent's.
+        void* page = alloc_page();
+        memcpy(page, parent->uring, PGSIZE);
+        map_pages(child->pagetable, parent->mapped_info[i].va, PGSIZE, (uint64)page,
+                  prot_to_type(PROT_WRITE | PROT_READ, 1));
+        child->mapped_info[child->total_mapped_region] = parent->mapped_info[i];
+        ++ child->total_mapped_region;
+        child->uring = (struct uring*)page;
+        break;
+      }
     }
   }
 
+  fpu_fork( parent, child );
+
   child->status = READY;
   child->trapframe->regs.a0 = 0;
   child->parent = parent;
+  group_attach( child, parent->group );
+  child->nice = parent->nice;
+  child->weight = parent->weight;
 
   child->tick_count = 0;
   child->total_tick_count = 0;
@@ -328,7 +438,126 @@ int do_fork( process* parent)
   return child->pid;
 }
 
-int do_wait(int pid){
+//
+// implements spawn: run shell command name with the arguments argv (user addresses of the
+// current process) in a new child, which gets its address space from the elf directly, not
+// from a copy of the parent's as with fork and exec. the child inherits the open files of
+// the parent, changed by the n file actions acts. returns the pid of the child, or -1.
+//
+int do_spawn( char* name, char** argv, struct spawn_action* acts, int n )
+{
+  if( files_check_actions( current->pfiles, acts, n ) != 0 ) return -1;
+
+  process* child = spawn_bincode_from_host_elf( name, argv );
+  if( !child ) return -1;
+  files_inherit( child->pfiles, current->pfiles, acts, n );
+
+  child->status = READY;
+  child->parent = current;
+  group_attach( child, current->group );
+  child->nice = current->nice;
+  child->weight = current->weight;
+  child->total_mem_count = child->total_mapped_region;
+  insert_to_ready_queue( child );
+
+  return child->pid;
+}
+
+//
+// implements vfork: the child runs on the address space of the current process, with a
+// kernel stack and a trapframe of its own, until it calls exec or exit. nothing of the
+// address space is copied, which is all a child that calls exec right away needs. the
+// parent sleeps until then, and its restarted vfork returns the pid of the child.
+//
+int do_vfork()
+{
+  process* parent = current;
+  process* child = parent->vfork_child;
+
+  // the restarted system call: the child is done with the address space, or not yet.
+  if( child ){
+    if( child->vfork_parent == parent ) sleep_on( &parent->vfork_wait );
+    parent->vfork_child = NULL;
+    return child->pid;
+  }
+
+  child = alloc_process_struct();
+  *child->trapframe = *parent->trapframe;
+  child->trapframe->regs.a0 = 0;
+  child->pagetable = parent->pagetable;
+  child->mapped_info = parent->mapped_info;
+  child->total_mapped_region = parent->total_mapped_region;
+  child->vdso = parent->vdso;
+  // the trap vector reaches the trapframe through the user page table.
+  if( !g_kmap_shared )
+    user_vm_map( child->pagetable, (uint64)child->trapframe, PGSIZE, (uint64)child->trapframe,
+      prot_to_type( PROT_WRITE | PROT_READ, 0 ) );
+  child->pfiles = files_create();
+  files_inherit( child->pfiles, parent->pfiles, NULL, 0 );
+  fpu_fork( parent, child );
+
+  child->status = READY;
+  child->parent = parent;
+  child->vfork_parent = parent;
+  group_attach( child, parent->group );
+  child->nice = parent->nice;
+  child->weight = parent->weight;
+  insert_to_ready_queue( child );
+
+  parent->vfork_child = child;
+  sleep_on( &parent->vfork_wait );
+  return -1;
+}
+
+//
+// free what is left of a process that exited (or never ran): its kernel stack, address
+// space and trapframe. the process structure is FREE afterwards.
+//
+void reclaim_process( process* proc ) {
+  free_page((void*)proc->kstack-PGSIZE);  // 释放 kstack
+
+  for( int j=0; j<proc->total_mapped_region; ++ j ){
+    switch( proc->mapped_info[j].seg_type ){
+      case STACK_SEGMENT:   // free user stack
+      case CONTEXT_SEGMENT: // free trapframe
+      case DATA_SEGMENT:    // free data segment
+      case SHARED_SEGMENT:  // free the uring page
+      case VDSO_SEGMENT:    // free the kernel data page
+        user_vm_unmap(proc->pagetable, 
+                      proc->mapped_info[j].va, 
+                      proc->mapped_info[j].npages*PGSIZE, 
+                      1);   // 取消映射并释放物理页
+        break;
+      case CODE_SEGMENT:
+        user_vm_unmap(proc->pagetable, 
+                      proc->mapped_info[j].va,
+                      proc->mapped_info[j].npages*PGSIZE,
+                      0);   // 只取消映射，不释放代码段物理页
+        break;
+    }
+  }
+  // a trapframe that is not mapped in the user page table (shared kernel mappings) was
+  // not freed by the unmapping. a vfork child that exited before exec has no address
+  // space of its own (see vfork_release).
+  if (g_kmap_shared || !proc->pagetable) free_page(proc->trapframe);
+  if (proc->pagetable) {
+    free_page(proc->mapped_info);
+    free_page(proc->pagetable);
+  }
+  fpu_free(proc);
+#ifdef SYSCALL_STATS
+  free_page(proc->syscall_stats);
+#endif
+  proc->status = FREE;
+  proc->parent = NULL;
+  proc->queue_next = NULL;
+  proc->on_queue = 0;
+  proc->tick_count = 0;
+  proc->total_mem_count = 0;
+  proc->total_tick_count = 0;
+}
+
+int do_wait(int pid, uint64 deadline){
   int havekids, child_pid;
   havekids = 0;
   // Scan through table looking for zombie children.
@@ -344,34 +573,7 @@ int do_wait(int pid){
 
       child_pid = procs[i].pid;
 
-      free_page((void*)procs[i].kstack-PGSIZE);  // 释放 kstack
-
-      for( int j=0; j<procs[i].total_mapped_region; ++ j ){
-        switch( procs[i].mapped_info[j].seg_type ){
-          case STACK_SEGMENT:   // free user stack
-          case CONTEXT_SEGMENT: // free trapframe
-          case DATA_SEGMENT:    // free data segment
-            user_vm_unmap(procs[i].pagetable, 
-                          procs[i].mapped_info[j].va, 
-                          procs[i].mapped_info[j].npages*PGSIZE, 
-                          1);   // 取消映射并释放物理页
-            break;
-          case CODE_SEGMENT:
-            user_vm_unmap(procs[i].pagetable, 
-                          procs[i].mapped_info[j].va,
-                          procs[i].mapped_info[j].npages*PGSIZE,
-                          0);   // 只取消映射，不释放代码段物理页
-            break;
-        }
-      }
-      free_page(procs[i].mapped_info);
-      free_page(procs[i].pagetable);
-      procs[i].status = FREE;
-      procs[i].parent = NULL;
-      procs[i].queue_next = NULL;
-      procs[i].tick_count = 0;
-      procs[i].total_mem_count = 0;
-      procs[i].total_tick_count = 0;
+      reclaim_process( &procs[i] );
       return child_pid;
     }
   }
@@ -380,14 +582,40 @@ int do_wait(int pid){
     return -1;
   }
 
+  // no child has exited yet. block until one does (see free_process), the wait syscall is
+  // then restarted and finds it. at the deadline, wait returns -2.
+  if ( deadline )
+    sleep_on_timeout( &current->wait_child, deadline, -2 );
+  else
+    sleep_on( &current->wait_child );
   return -2;
 }
 
 int do_exec(char * path, char ** argv){
-  load_shell_bincode_from_host_elf(user_va_to_pa(current->pagetable, argv));
+  load_shell_bincode_from_host_elf(argv);
   return 1; 
 }
 
+//
+// aging scan, called from the timer tick every WSS_SCAN_INTERVAL ticks. samples and clears
+// the accessed/dirty bits of every live process, and records its working-set size.
+//
+void age_working_sets() {
+  wss_sample s;
+
+  for ( int i = 0; i < NPROC; ++ i ){
+    // a vfork child is counted with its parent, whose pages it uses.
+    if ( procs[i].status == FREE || procs[i].status == ZOMBIE || procs[i].vfork_parent )
+      continue;
+    user_vm_age(procs[i].pagetable, &s);
+    // a hart running the process may still hold cleared accessed/dirty bits in its tlb.
+    tlb_shootdown(procs[i].pagetable);
+    procs[i].wss_pages  = s.referenced;
+    procs[i].wss_dirty  = s.dirtied;
+    procs[i].idle_pages = s.idle;
+  }
+}
+
 int do_getinfo(){
   sprint("top - \n");
   // process status
@@ -402,11 +630,42 @@ int do_getinfo(){
     nprocs[0], nprocs[READY], nprocs[RUNNING], nprocs[BLOCKED], nprocs[ZOMBIE]);
 
   sprint("Cpu(s): %d ticks\n", g_ticks);
+  for ( int hart = 0; hart < NCPU; ++ hart ){
+    if ( !g_cpu_online[hart] ) continue;
+    if ( g_current[hart] )
+      sprint("  hart %d: running %d\n", hart, g_current[hart]->pid);
+    else
+      sprint("  hart %d: idle\n", hart);
+  }
 
   sprint("KiB Mem: %d\n", (g_mem_size >> 10));
 
-  sprint("\nPID\tS\tMEM\tTICK\n");
-  int pid, tick, mem;
+#ifdef LOCK_STAT
+  sprint("Kernel lock: %ld acquired, %ld contended, %ld spins\n", g_kernel_lock.stat.acquired,
+    g_kernel_lock.stat.contended, g_kernel_lock.stat.spins);
+#endif
+
+  sprint("KSM: %d merged, %d unmerged, %d shared frames, %ld merges, %ld cow breaks\n",
+    ksm_stat.merged, ksm_stat.unmerged, ksm_stat.shared, ksm_stat.merges, ksm_stat.cow_breaks);
+
+  for ( int id = 0; id < NGROUP; ++ id ){
+    cpu_group *group = &cpu_groups[id];
+    if ( !group->in_use ) continue;
+    sprint("Group %d: %d procs, quota %ld/%ld us, usage %ld us, throttled %ld times, %ld us\n",
+      id, group->nr_procs, time_to_ns(group->quota) / 1000, time_to_ns(group->period) / 1000,
+      time_to_ns(group->usage) / 1000, group->nr_throttled,
+      time_to_ns(group->throttled_time) / 1000);
+  }
+
+  // share of the processor, measured over the runtime of all live processes
+  uint64 total_runtime = 0;
+  for ( int i = 0; i < NPROC; ++ i )
+    if ( procs[i].status != FREE ) total_runtime += procs[i].sum_exec_runtime;
+  if ( total_runtime == 0 ) total_runtime = 1;
+
+  // USR, SYS and WAIT in microseconds
+  sprint("\nPID\tS\tNI\tMEM\tWSS\tDIRTY\tIDLE\tTICK\tRTIME\tCPU\tUSR\tSYS\tWAIT\tVCSW\tIVCSW\tMISS\n");
+  int pid, tick, mem, wss, dirty, idle;
   char stat;
   for ( int i = 0; i < NPROC; ++ i ){
     if ( procs[i].status != FREE ){
@@ -419,9 +678,47 @@ int do_getinfo(){
         case ZOMBIE:  stat = 'Z'; break;
       }
       mem = procs[i].total_mem_count * 4;
+      wss = procs[i].wss_pages * 4;
+      dirty = procs[i].wss_dirty * 4;
+      idle = procs[i].idle_pages * 4;
       tick = procs[i].total_tick_count;
-      sprint("%d\t%c\t%d\t%d\n", pid, stat, mem, tick);
+      sprint("%d\t%c\t%d\t%d\t%d\t%d\t%d\t%d\t%ld\t%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\n", pid, stat,
+        procs[i].nice, mem, wss, dirty, idle, tick, procs[i].sum_exec_runtime,
+        (int)(procs[i].sum_exec_runtime * 100 / total_runtime),
+        time_to_ns(procs[i].utime) / 1000, time_to_ns(procs[i].stime) / 1000,
+        time_to_ns(procs[i].wait_time) / 1000, procs[i].nvcsw, procs[i].nivcsw,
+        procs[i].dl_misses);
     }
   }
   return 1;
-}
\ No newline at end of file
+}
+//
+// fill st with the cpu accounting of process pid (0 for the current process). the time
+// the current process spent in the kernel so far is charged first, so that it is exact.
+// returns -1 if there is no such process.
+//
+int do_getstat(int pid, struct proc_stat *st) {
+  process *proc = pid == 0 ? current : NULL;
+
+  for (int i = 0; !proc && i < NPROC; i++)
+    if (procs[i].status != FREE && procs[i].pid == pid) proc = &procs[i];
+  if (!proc) return -1;
+
+  if (proc == current) acct_user_return(proc);
+  proc_getstat(proc, st);
+  return 0;
+}
+
+//
+// fill st with the cpu accounting of proc, as of its last update.
+//
+void proc_getstat(process *proc, struct proc_stat *st) {
+  st->utime = time_to_ns(proc->utime);
+  st->stime = time_to_ns(proc->stime);
+  st->wtime = time_to_ns(proc->wait_time);
+  st->ucycles = proc->ucycles;
+  st->scycles = proc->scycles;
+  st->nvcsw = proc->nvcsw;
+  st->nivcsw = proc->nivcsw;
+  st->dl_misses = proc->dl_misses;
+}
@@ -2,6 +2,10 @@
 #define _PROC_H_
 
 #include "riscv.h"
+#include "smp.h"
+#include "timer.h"
+#include "proc_stat.h"
+#include "spawn.h"
 
 typedef struct trapframe {
   // space to store context (all common registers)
@@ -16,8 +20,28 @@ typedef struct trapframe {
 
   //kernel page table
   /* offset:272 */ uint64 kernel_satp;
+  // hart the process runs on, loaded into tp at the kernel entry
+  /* offset:280 */ uint64 kernel_hartid;
 }trapframe;
 
+// the units whose state is switched lazily (see fpu.c): floating point (F/D) and vector (V)
+#define FPU_FP 0
+#define FPU_VEC 1
+#define FPU_UNITS 2
+
+// floating point registers of a process
+typedef struct fp_state {
+  uint64 f[32];
+  uint64 fcsr;
+} fp_state;
+
+// vector registers of a process. v0-v31 take 32 * vlenb bytes, in a page of their own that
+// is allocated at the first use.
+typedef struct vec_state {
+  uint64 vstart, vl, vtype, vcsr;
+  void *regs;
+} vec_state;
+
 // PKE kernel supports at most 32 processes
 #define NPROC 32
 
@@ -37,6 +61,8 @@ enum segment_type {
   STACK_SEGMENT,   // runtime segment
   CONTEXT_SEGMENT, // trapframe segment
   SYSTEM_SEGMENT,  // system segment
+  SHARED_SEGMENT,  // page shared with the kernel (uring), which accesses it directly
+  VDSO_SEGMENT,    // kernel data page, read-only to the process (see vdso.c)
 };
 
 // the VM regions mapped to a user process
@@ -46,6 +72,12 @@ typedef struct mapped_region {
   uint32 seg_type; // segment type, one of the segment_types
 } mapped_region;
 
+// processes blocked on an event (see sleep_on and wakeup in sched.c), in FIFO order
+typedef struct wait_queue {
+  struct process *head;
+  struct process *tail;
+} wait_queue;
+
 // the extremely simple definition of process, used for begining labs of PKE
 typedef struct process {
   // pointing to the stack used in trap handling.
@@ -68,6 +100,58 @@ typedef struct process {
   struct process *parent;
   // next queue element
   struct process *queue_next;
+  // priority level in the ready queue (0 is the highest)
+  int priority;
+  // set while the process is linked in the ready queue
+  int on_queue;
+  // hart whose run queue holds the process, or that it last ran on
+  int cpu;
+
+  // wait queue the process is blocked on, and its neighbours there
+  wait_queue *waiting_on;
+  struct process *wait_next;
+  struct process *wait_prev;
+  // the process sleeps here in wait() until one of its children exits
+  wait_queue wait_child;
+  // vfork: a child runs on the address space of vfork_parent until it calls exec or exit
+  // (see vfork_release). the parent sleeps on vfork_wait meanwhile, with the child in
+  // vfork_child.
+  struct process *vfork_parent;
+  struct process *vfork_child;
+  wait_queue vfork_wait;
+  // ends a sleep at its deadline (see sleep_on_timeout), and the value returned then
+  ktimer sleep_timer;
+  long sleep_ret;
+
+  // fair-share (cfs) scheduling
+  int nice;                 // nice value, -20 .. 19
+  uint32 weight;            // weight of the nice value
+  uint64 vruntime;          // runtime scaled by NICE_0_WEIGHT / weight
+  int heap_index;           // position in the cfs heap, -1 if not queued
+  uint64 exec_start;        // rdtime when the runtime was last charged
+  uint64 sum_exec_runtime;  // total runtime (in rdtime units)
+
+  // cpu bandwidth group (see group.c)
+  struct cpu_group *group;
+
+  // earliest-deadline-first class (see sched_setdeadline), in rdtime units. dl_period is 0
+  // for a best-effort process.
+  uint64 dl_runtime, dl_deadline, dl_period;
+  uint64 dl_period_start;   // release time of the current job
+  uint64 dl_abs_deadline;   // absolute deadline of the current job
+  int64 dl_budget;          // runtime left to the current job
+  int dl_throttled;         // DL_OVERRUN or DL_DONE while waiting for the next period
+  int dl_missed;            // set once the current job has missed its deadline
+  uint64 dl_misses;         // number of jobs that missed their deadline
+  ktimer dl_timer;          // releases the next job of a throttled process
+
+  // cpu accounting (see acct_kernel_entry in sched.c), in rdtime units and cycles
+  uint64 utime, stime, wait_time;
+  uint64 ucycles, scycles;
+  uint64 nvcsw, nivcsw;     // voluntary and involuntary context switches
+  uint64 acct_time;         // rdtime at the last switch between user mode and the kernel
+  uint64 acct_cycle;        // rdcycle at the same moment
+  uint64 ready_since;       // rdtime when the process was last queued as ready
 
   // accounting
   int tick_count;
@@ -75,31 +159,75 @@ typedef struct process {
   int total_tick_count;
   int total_mem_count;
 
+  // working set, refreshed by the aging scan (in pages)
+  int wss_pages;   // pages referenced during the last scan window
+  int wss_dirty;   // pages written during the last scan window
+  int idle_pages;  // pages not referenced for two or more scan windows
+
   // file
   struct files_struct * pfiles;
+
+  // submission/completion rings, NULL until uring_setup (see uring.c)
+  struct uring *uring;
+
+  // kernel data page, mapped at VDSO_VA
+  struct vdso_data *vdso;
+
+  // floating point and vector state, saved only when the process dirtied it and leaves the
+  // hart, and restored at the first use after that (see fpu.c)
+  fp_state fp;
+  vec_state vec;
+  int fpu_cpu[FPU_UNITS];   // hart whose registers hold the state of a unit, -1 if none
+  int fpu_used[FPU_UNITS];  // set once the saved state of a unit is not the initial one
+
+#ifdef SYSCALL_STATS
+  // counters of each system call (see syscall_stat.h), in a page of their own
+  struct syscall_stat *syscall_stats;
+#endif
 }process;
 
 // switch to run user app
 void switch_to(process*);
+// bookkeeping before the current process returns to user mode, returns the satp to use
+uint64 prepare_return(process* proc);
 // initialize process pool (the procs[] array)
 void init_proc_pool();
 // allocate an empty process, init its vm space. returns its pid
 process* alloc_process();
 // reclaim a process, destruct its vm space and free physical pages.
 int free_process( process* proc );
+void reclaim_process( process* proc );
 // reallocate procs[i]
 void realloc_process(int i);
 // fork a child from parent
 int do_fork(process* parent);
-// wait for a child
-int do_wait(int pid);
+// start a shell command in a new child, without fork and exec
+int do_spawn(char* name, char** argv, struct spawn_action* acts, int n);
+// start a child on the address space of the current process, until it calls exec or exit
+int do_vfork();
+// wait for a child, until deadline (in rdtime units) if it is not 0
+int do_wait(int pid, uint64 deadline);
 // exec
 int do_exec(char * path, char ** argv);
 // get info
 int do_getinfo();
-
-// current running process
-extern process* current;
+// batched system calls (uring.c)
+uint64 do_uring_setup();
+int do_uring_enter(int to_submit);
+// fill st with the cpu accounting of process pid (0 for the current process)
+int do_getstat(int pid, struct proc_stat *st);
+void proc_getstat(process* proc, struct proc_stat *st);
+// kernel data page (vdso.c)
+void vdso_hart_init();
+void vdso_map(process* proc);
+void vdso_update(process* proc);
+// sample the accessed/dirty bits of all live processes
+void age_working_sets();
+
+// running process of each hart (NULL while the hart is idle)
+extern process* g_current[NCPU];
+// current running process (on this hart)
+#define current (g_current[cpuid()])
 // virtual address of our simple heap
 extern uint64 g_ufree_page;
 
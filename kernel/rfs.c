@@ -2,6 +2,7 @@
 #include "rfs.h"
 #include "dev.h"
 #include "pmm.h"
+#include "klog.h"
 #include "util/string.h"
 #include "spike_interface/spike_utils.h"
 
@@ -368,7 +369,7 @@ int rfs_read(struct inode *node, char *buf, uint64 len){
   if ( din->size < len )
     len = din->size;
 
-  sprint("rfs_read: len: %d\n", len);
+  klog_debug("rfs_read: len: %d\n", len);
   char buffer[len+1];
 
   struct fs * fs = node->in_fs;
@@ -378,7 +379,7 @@ int rfs_read(struct inode *node, char *buf, uint64 len){
   int remain   = len % RFS_BLKSIZE;
   if ( remain > 0 )
     ++ readtime;
-  sprint("rfs_read: read %d times from disk. \n", readtime);
+  klog_debug("rfs_read: read %d times from disk. \n", readtime);
 
   int offset = 0;
   int i = 0;
@@ -395,7 +396,7 @@ int rfs_read(struct inode *node, char *buf, uint64 len){
   buffer[len] = '\0';
 
   strcpy(buf, buffer);
-  return 0;
+  return len;
 }
 
 int rfs_write(struct inode *node, char *buf, uint64 len){
@@ -411,7 +412,7 @@ int rfs_write(struct inode *node, char *buf, uint64 len){
   int remain    = len % RFS_BLKSIZE;
   if ( remain > 0 )
     ++ writetime;
-  sprint("rfs_write: write %d times from disk. \n", writetime);
+  klog_debug("rfs_write: write %d times from disk. \n", writetime);
 
   int offset = 0;
   int i = 0;
@@ -436,7 +437,103 @@ int rfs_write(struct inode *node, char *buf, uint64 len){
   din->size   = (strlen(buf)+1) * sizeof(char);
   din->blocks = nblocks;
   rfs_w1block(rfs, node->inum);
-  return 0;
+  return len;
+}
+
+//
+// copy len bytes between buf and the pieces of an i/o vector, from piece *i at offset *ioff
+// on, which move past the bytes copied.
+//
+static void rfs_iov_copy(struct kiov *iov, int *i, uint64 *ioff, char *buf, uint64 len,
+                         int to_iov){
+  while ( len > 0 ){
+    uint64 n = iov[*i].len - *ioff < len ? iov[*i].len - *ioff : len;
+    if ( to_iov )
+      memcpy(iov[*i].base + *ioff, buf, n);
+    else
+      memcpy(buf, iov[*i].base + *ioff, n);
+    buf += n;
+    len -= n;
+    *ioff += n;
+    if ( *ioff == iov[*i].len ){
+      ++ *i;
+      *ioff = 0;
+    }
+  }
+}
+
+//
+// give the file blocks up to block b, cleared.
+//
+static void rfs_grow(struct rfs_fs *rfs, struct rfs_dinode *din, int b){
+  while ( din->blocks <= b ){
+    int blkno = rfs_alloc_block(rfs);
+    memset(rfs->buffer, 0, RFS_BLKSIZE);
+    rfs_w1block(rfs, blkno);
+    din->addrs[din->blocks++] = blkno;
+  }
+}
+
+//
+// move the bytes at [off, off + length of iov) of a file between its blocks and the pieces
+// of iov, a block at a time. a piece that covers a whole block is copied by the device
+// directly, the other blocks go through the block buffer of the file system. returns the
+// number of bytes moved, less at the end of the file (read) or of its largest size (write).
+//
+static int rfs_rwv(struct inode *node, struct kiov *iov, int n, uint64 off, int write){
+  struct rfs_fs * rfs = fsop_info(node->in_fs, RFS_TYPE);
+  struct rfs_dinode * din = vop_info(node, RFS_TYPE);
+  uint64 limit = write ? RFS_NDIRECT * RFS_BLKSIZE : din->size;
+  uint64 total = 0, done = 0, ioff = 0;
+  int i = 0;
+
+  for ( int k = 0; k < n; ++ k ) total += iov[k].len;
+  if ( off >= limit ) return write && total ? -1 : 0;
+  if ( off + total > limit ) total = limit - off;
+
+  while ( done < total ){
+    int b = (off + done) / RFS_BLKSIZE;
+    uint64 boff = (off + done) % RFS_BLKSIZE;
+    uint64 len = RFS_BLKSIZE - boff < total - done ? RFS_BLKSIZE - boff : total - done;
+
+    if ( write ) rfs_grow(rfs, din, b);
+    if ( len == RFS_BLKSIZE && iov[i].len - ioff >= RFS_BLKSIZE ){
+      if ( write )
+        dop_input(rfs->dev, iov[i].base + ioff, din->addrs[b]);
+      else
+        dop_output(rfs->dev, iov[i].base + ioff, din->addrs[b]);
+      ioff += RFS_BLKSIZE;
+      if ( ioff == iov[i].len ){
+        ++ i;
+        ioff = 0;
+      }
+    }else{
+      if ( !write || len < RFS_BLKSIZE ) rfs_r1block(rfs, din->addrs[b]);
+      rfs_iov_copy(iov, &i, &ioff, (char *)rfs->buffer + boff, len, !write);
+      if ( write ) rfs_w1block(rfs, din->addrs[b]);
+    }
+    done += len;
+  }
+
+  // write disk-inode (size, blocks)
+  if ( write ){
+    if ( off + total > din->size ) din->size = off + total;
+    rfs_r1block(rfs, node->inum);
+    struct rfs_dinode * ddin = (struct rfs_dinode *)rfs->buffer; // dinode
+    ddin->size   = din->size;
+    ddin->blocks = din->blocks;
+    memcpy(ddin->addrs, din->addrs, sizeof(din->addrs));
+    rfs_w1block(rfs, node->inum);
+  }
+  return total;
+}
+
+int rfs_readv(struct inode *node, struct kiov *iov, int n, uint64 off){
+  return rfs_rwv(node, iov, n, off, 0);
+}
+
+int rfs_writev(struct inode *node, struct kiov *iov, int n, uint64 off){
+  return rfs_rwv(node, iov, n, off, 1);
 }
 
 // The sfs specific DIR operations correspond to the abstract operations on a inode.
@@ -459,6 +556,8 @@ static const struct inode_ops rfs_node_fileops = {
   .vop_close              = rfs_close,
   .vop_read               = rfs_read,
   .vop_write              = rfs_write,
+  .vop_readv              = rfs_readv,
+  .vop_writev             = rfs_writev,
   .vop_fstat              = rfs_fstat,
   // .vop_fsync                      = sfs_fsync,
   // .vop_reclaim                    = sfs_reclaim,
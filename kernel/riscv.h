@@ -54,15 +54,23 @@
 
 // irqs (interrupts)
 #define CAUSE_MTIMER 0x8000000000000007
+#define CAUSE_MSOFT 0x8000000000000003
 #define CAUSE_MTIMER_S_TRAP 0x8000000000000001
+#define CAUSE_STIMER_S_TRAP 0x8000000000000005  // supervisor timer (Sstc)
 
 //Supervisor interrupt-pending register
 #define SIP_SSIP (1L << 1)
+#define SIP_STIP (1L << 5)
+
+// menvcfg (CSR 0x30a): STCE enables stimecmp (Sstc) for supervisor mode
+#define MENVCFG_STCE (1UL << 63)
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4 * (hartid))  // machine software interrupt (IPI)
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8 * (hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8)  // cycles since boot.
+#define CLINT_SIZE 0x10000
 
 // fields of sstatus, the Supervisor mode Status register
 #define SSTATUS_SPP (1L << 8)   // Previous mode, 1=Supervisor, 0=User
@@ -71,13 +79,18 @@
 #define SSTATUS_SIE (1L << 1)   // Supervisor Interrupt Enable
 #define SSTATUS_UIE (1L << 0)   // User Interrupt Enable
 #define SSTATUS_SUM 0x00040000
-#define SSTATUS_FS 0x00006000
+#define SSTATUS_FS 0x00006000  // floating point unit state (off, initial, clean, dirty)
+#define SSTATUS_VS 0x00000600  // vector unit state
 
 // Supervisor Interrupt Enable
 #define SIE_SEIE (1L << 9)  // external
 #define SIE_STIE (1L << 5)  // timer
 #define SIE_SSIE (1L << 1)  // software
 
+// Supervisor Counter Enable: counters that user mode may read
+#define SCOUNTEREN_CY (1L << 0)  // cycle
+#define SCOUNTEREN_TM (1L << 1)  // time
+
 // Machine-mode Interrupt Enable
 #define MIE_MEIE (1L << 11)  // external
 #define MIE_MTIE (1L << 7)   // timer
@@ -147,6 +160,16 @@ static inline uint64 read_tp(void) {
 // write tp, the thread pointer, holding hartid (core number), the index into cpus[].
 static inline void write_tp(uint64 x) { asm volatile("mv tp, %0" : : "r"(x)); }
 
+// read the real-time counter (mtime, counting at the timebase frequency)
+static inline uint64 read_time(void) { return read_csr(time); }
+
+// read the cycle counter of this hart
+static inline uint64 read_cycle(void) { return read_csr(cycle); }
+
+// the csrs of Sstc are written by number, for assemblers that do not know their names.
+static inline void write_stimecmp(uint64 x) { asm volatile("csrw 0x14d, %0" : : "r"(x)); }
+static inline void set_menvcfg(uint64 bits) { asm volatile("csrs 0x30a, %0" : : "r"(bits)); }
+
 static inline void flush_tlb(void) { asm volatile("sfence.vma zero, zero"); }
 #define PGSIZE 4096  // bytes per page
 #define PGSHIFT 12   // bits of offset within a page
@@ -163,6 +186,9 @@ static inline void flush_tlb(void) { asm volatile("sfence.vma zero, zero"); }
 #define PTE_G (1L << 5)  // Global
 #define PTE_A (1L << 6)  // Accessed
 #define PTE_D (1L << 7)  // Dirty
+// software-defined (RSW) bits
+#define PTE_IDLE (1L << 8)  // not accessed during the previous aging scan
+#define PTE_COW (1L << 9)   // shared read-only page, copied on the first write
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
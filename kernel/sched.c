@@ -3,71 +3,836 @@
  */
 
 #include "sched.h"
+#include "strap.h"
+#include "group.h"
+#include "fpu.h"
+#include "vmm.h"
+#include "string.h"
+#include "klog.h"
+#include "util/functions.h"
 #include "spike_interface/spike_utils.h"
 
-process* ready_queue_head = NULL;
+//
+// one run queue per hart. a process is queued on the hart it last ran on (proc->cpu), and
+// a hart whose queue is empty steals from the busiest other queue.
+//
+run_queue run_queues[NCPU];
+#define this_rq() (&run_queues[cpuid()])
+
+// stack of each hart while it is idle, i.e., runs no process
+static char idle_stack[NCPU][PGSIZE] __attribute__((aligned(16)));
+
+// time (rdtime) of the next scheduler tick of each hart, and whether the hart runs without
+// ticks (see sched_program_timer)
+static uint64 next_tick[NCPU];
+static int tickless[NCPU];
+
+// global variable that store the recorded "ticks" in strap.c
+extern uint64 g_ticks;
 
 //
-// insert a process, proc, into the END of ready queue.
+// index of the lowest set bit of a non-zero x (de Bruijn multiplication, branch free).
 //
-void insert_to_ready_queue( process* proc ) {
-  sprint( "going to insert process %d to ready queue.\n", proc->pid );
-  // if the queue is empty in the beginning
-  if( ready_queue_head == NULL ){
-    proc->status = READY;
-    proc->queue_next = NULL;
-    ready_queue_head = proc;
-    return;
-  }
-
-  // ready queue is not empty
-  process *p;
-  // browse the ready queue to see if proc is already in-queue
-  for( p=ready_queue_head; p->queue_next!=NULL; p=p->queue_next )
-    if( p == proc ) return;  //already in queue
-
-  // p points to the last element of the ready queue
-  if( p==proc ) return;
-  p->queue_next = proc;
-  proc->status = READY;
+static inline int lowest_set_bit(uint32 x) {
+  static const int debruijn[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9 };
+  return debruijn[((x & -x) * 0x077CB531U) >> 27];
+}
+
+//
+// append proc to the tail of its priority level.
+//
+static void rq_enqueue( run_queue* rq, process* proc ) {
+  int prio = proc->priority;
+
   proc->queue_next = NULL;
+  if( rq->tail[prio] )
+    rq->tail[prio]->queue_next = proc;
+  else
+    rq->head[prio] = proc;
+  rq->tail[prio] = proc;
+  rq->bitmap |= 1U << prio;
+  rq->nr_ready++;
+  proc->on_queue = 1;
+}
 
-  return;
+//
+// remove and return the first process of the highest non-empty priority level.
+//
+static process* rq_dequeue( run_queue* rq ) {
+  if( !rq->bitmap ) return NULL;
+
+  int prio = lowest_set_bit( rq->bitmap );
+  process* proc = rq->head[prio];
+
+  rq->head[prio] = proc->queue_next;
+  if( !rq->head[prio] ){
+    rq->tail[prio] = NULL;
+    rq->bitmap &= ~(1U << prio);
+  }
+  rq->nr_ready--;
+  proc->queue_next = NULL;
+  proc->on_queue = 0;
+  return proc;
 }
 
 //
-// choose a proc from the ready queue, and put it to run.
-// note: schedule() does not take care of previous current process. If the current
-// process is still runnable, you should place it into the ready queue (by calling
-// ready_queue_insert), and then call schedule().
+// move every queued process to the highest priority level, keeping their order.
+//
+static void rq_boost( run_queue* rq ) {
+  for( int prio = 1; prio < NPRIO; prio++ ){
+    if( !rq->head[prio] ) continue;
+    for( process* p = rq->head[prio]; p; p = p->queue_next ) p->priority = 0;
+
+    if( rq->tail[0] )
+      rq->tail[0]->queue_next = rq->head[prio];
+    else
+      rq->head[0] = rq->head[prio];
+    rq->tail[0] = rq->tail[prio];
+    rq->head[prio] = rq->tail[prio] = NULL;
+  }
+  if( rq->bitmap ) rq->bitmap = 1;
+}
+
+//
+// the running process is preempted: put it back in the ready queue, and run another one.
+//
+static void preempt( process* proc ) {
+  ++ proc->nivcsw;
+  insert_to_ready_queue( proc );
+  schedule();
+}
+
+/* --- round-robin policy --- */
+
+//
+// implements round-robin scheduling: a process runs for TIME_SLICE_LEN ticks, and is then
+// placed at the rear of the ready queue.
+//
+static void rr_tick( process* proc ) {
+  ++ proc->tick_count;
+  if ( proc->tick_count >= TIME_SLICE_LEN ){
+    proc->tick_count = 0;
+    preempt( proc );
+  }
+}
+
+static void rr_yield( process* proc ) {
+  proc->tick_count = 0;
+}
+
+/* --- multi-level feedback queue policy --- */
+
+// time slice of an MLFQ level, longer for the lower priority levels
+#define MLFQ_QUANTUM(level) (TIME_SLICE_LEN << (level))
+
+//
+// a process that used up its whole slice is CPU bound, and moves one level down. every
+// MLFQ_BOOST_INTERVAL ticks all processes go back to the top level, so that long-running
+// processes at the bottom cannot starve. g_ticks follows the time, and the ticks of a hart
+// may step over a multiple of the interval: the queue remembers its last boost instead.
+//
+static void mlfq_tick( process* proc ) {
+  run_queue* rq = this_rq();
+
+  if ( g_ticks - rq->last_boost >= MLFQ_BOOST_INTERVAL ){
+    rq->last_boost = g_ticks;
+    rq_boost( rq );
+    proc->priority = 0;
+  }
+
+  ++ proc->tick_count;
+  if ( proc->tick_count >= MLFQ_QUANTUM(proc->priority) ){
+    proc->tick_count = 0;
+    if ( proc->priority < MLFQ_LEVELS - 1 ) ++ proc->priority;
+    preempt( proc );
+  }
+}
+
+//
+// a process that yields (or blocks) before its slice ends is interactive or I/O bound,
+// and moves one level up.
+//
+static void mlfq_yield( process* proc ) {
+  if ( proc->tick_count < MLFQ_QUANTUM(proc->priority) && proc->priority > 0 )
+    -- proc->priority;
+  proc->tick_count = 0;
+}
+
+/* --- fair-share (CFS-like) policy --- */
+
+//
+// weights of nice levels -20 .. 19 (as in Linux). nice 0 has weight NICE_0_WEIGHT, and every
+// nice step changes the share of the processor by about 10%.
+//
+static const uint32 nice_to_weight[40] = {
+  88761, 71755, 56483, 46273, 36291,
+  29154, 23254, 18705, 14949, 11916,
+  9548,  7620,  6100,  4904,  3906,
+  3121,  2501,  1991,  1586,  1277,
+  1024,  820,   655,   526,   423,
+  335,   272,   215,   172,   137,
+  110,   87,    70,    56,    45,
+  36,    29,    23,    18,    15,
+};
+
+#define vruntime_before(a, b) ((int64)((a) - (b)) < 0)
+
+static void cfs_heap_swap( run_queue* rq, int i, int j ) {
+  process* t = rq->heap[i];
+  rq->heap[i] = rq->heap[j];
+  rq->heap[j] = t;
+  rq->heap[i]->heap_index = i;
+  rq->heap[j]->heap_index = j;
+}
+
+static void cfs_heap_up( run_queue* rq, int i ) {
+  while( i > 0 && vruntime_before( rq->heap[i]->vruntime, rq->heap[(i-1)/2]->vruntime ) ){
+    cfs_heap_swap( rq, i, (i-1)/2 );
+    i = (i-1)/2;
+  }
+}
+
+static void cfs_heap_down( run_queue* rq, int i ) {
+  for( ;; ){
+    int min = i, l = 2*i + 1, r = 2*i + 2;
+    if( l < rq->heap_size && vruntime_before( rq->heap[l]->vruntime, rq->heap[min]->vruntime ) )
+      min = l;
+    if( r < rq->heap_size && vruntime_before( rq->heap[r]->vruntime, rq->heap[min]->vruntime ) )
+      min = r;
+    if( min == i ) return;
+    cfs_heap_swap( rq, i, min );
+    i = min;
+  }
+}
+
+//
+// queue proc in the min-heap ordered by virtual runtime. a process that was away (new, or
+// waiting) starts from the current minimum, so it cannot claim the time it did not run.
+//
+static void cfs_enqueue( run_queue* rq, process* proc ) {
+  if( vruntime_before( proc->vruntime, rq->min_vruntime ) )
+    proc->vruntime = rq->min_vruntime;
+
+  int i = rq->heap_size++;
+  rq->heap[i] = proc;
+  proc->heap_index = i;
+  cfs_heap_up( rq, i );
+  rq->nr_ready++;
+  proc->on_queue = 1;
+}
+
+//
+// pick the process with the lowest virtual runtime.
+//
+static process* cfs_dequeue( run_queue* rq ) {
+  if( rq->heap_size == 0 ) return NULL;
+
+  process* proc = rq->heap[0];
+  if( --rq->heap_size > 0 ){
+    rq->heap[0] = rq->heap[rq->heap_size];
+    rq->heap[0]->heap_index = 0;
+    cfs_heap_down( rq, 0 );
+  }
+  if( vruntime_before( rq->min_vruntime, proc->vruntime ) )
+    rq->min_vruntime = proc->vruntime;
+
+  rq->nr_ready--;
+  proc->heap_index = -1;
+  proc->on_queue = 0;
+  return proc;
+}
+
+//
+// preempt the running process once it is CFS_GRANULARITY ahead of the most starved one.
+// its virtual runtime is already up to date (see sched_tick).
+//
+static void cfs_tick( process* proc ) {
+  run_queue* rq = this_rq();
+  if( rq->heap_size == 0 ) return;
+
+  if( vruntime_before( rq->heap[0]->vruntime + CFS_GRANULARITY, proc->vruntime ) )
+    preempt( proc );
+}
+
+static void cfs_yield( process* proc ) {
+  // nothing to adjust: the virtual runtime is charged in sched_yield.
+}
+
+static const sched_policy sched_policies[] = {
+  { "rr",   rq_enqueue,  rq_dequeue,  rr_tick,   rr_yield },
+  { "mlfq", rq_enqueue,  rq_dequeue,  mlfq_tick, mlfq_yield },
+  { "cfs",  cfs_enqueue, cfs_dequeue, cfs_tick,  cfs_yield },
+};
+
+// the scheduling policy in use, selected by the "sched=" boot argument (default: rr)
+static const sched_policy* policy = &sched_policies[0];
+
+/* --- earliest deadline first class --- */
+
+// total bandwidth of the admitted deadline processes, in units of 1 / DL_BW_UNIT
+static uint64 dl_total_bw;
+
+// runtime is at most DL_RUNTIME_MAX (see sched_setdeadline), the shift does not overflow.
+static uint64 dl_bw( uint64 runtime, uint64 period ) {
+  return period ? (runtime << DL_BW_SHIFT) / period : 0;
+}
+
+//
+// queue proc in the deadline list of rq, behind the processes with the same deadline.
+//
+static void dl_enqueue( run_queue* rq, process* proc ) {
+  process** pp = &rq->dl_head;
+
+  while( *pp && (int64)((*pp)->dl_abs_deadline - proc->dl_abs_deadline) <= 0 )
+    pp = &(*pp)->queue_next;
+  proc->queue_next = *pp;
+  *pp = proc;
+  rq->nr_ready++;
+  proc->on_queue = 1;
+}
+
+static process* dl_dequeue( run_queue* rq ) {
+  process* proc = rq->dl_head;
+
+  rq->dl_head = proc->queue_next;
+  rq->nr_ready--;
+  proc->queue_next = NULL;
+  proc->on_queue = 0;
+  return proc;
+}
+
+// tell whether the deadline process proc should run ahead of the running process cur.
+static int dl_preempts( process* proc, process* cur ) {
+  return !cur->dl_period || (int64)(proc->dl_abs_deadline - cur->dl_abs_deadline) < 0;
+}
+
+//
+// release a new job of proc at start: a full runtime, due a relative deadline later.
+//
+static void dl_new_job( process* proc, uint64 start ) {
+  proc->dl_period_start = start;
+  proc->dl_abs_deadline = start + proc->dl_deadline;
+  proc->dl_budget = proc->dl_runtime;
+  proc->dl_missed = 0;
+}
+
+static void dl_check_miss( process* proc, uint64 now ) {
+  if( !proc->dl_missed && (int64)(now - proc->dl_abs_deadline) > 0 ){
+    proc->dl_missed = 1;
+    proc->dl_misses++;
+  }
+}
+
+//
+// the next period of a throttled process begins: release its next job. a job that overran
+// its runtime is not finished, and misses its deadline if that has passed meanwhile.
+//
+static void dl_replenish( ktimer* t ) {
+  process* proc = (process*)t->data;
+  uint64 now = read_time();
+  uint64 start = proc->dl_period_start + proc->dl_period;
+
+  if( proc->dl_throttled == DL_OVERRUN ) dl_check_miss( proc, now );
+  // periods that went by while the process was away are skipped.
+  if( (int64)(now - start) > 0 ) start = now;
+  dl_new_job( proc, start );
+  insert_to_ready_queue( proc );
+  proc->dl_throttled = 0;
+}
+
+//
+// stop the running deadline process until its next period, for reason (DL_OVERRUN or
+// DL_DONE), and run another process. does not return.
+//
+static void dl_throttle( process* proc, int reason ) {
+  proc->status = BLOCKED;
+  proc->dl_throttled = reason;
+  proc->dl_timer.func = dl_replenish;
+  proc->dl_timer.data = proc;
+  timer_add( &proc->dl_timer, time_to_jiffy_up( proc->dl_period_start + proc->dl_period ) );
+  schedule();
+}
+
+//
+// a deadline process wakes up from a sleep (constant bandwidth server rule): if its current
+// job cannot use the rest of its runtime before the deadline without exceeding its
+// bandwidth, it gets a new job (and deadline) instead, so it cannot steal time from others.
+//
+static void dl_wakeup( process* proc ) {
+  uint64 now = read_time();
+  int64 left = (int64)(proc->dl_abs_deadline - now);
+
+  // the products take up to 128 bits (a multiplication, no library call on RV64).
+  if( left <= 0 || (__uint128_t)(uint64)proc->dl_budget * proc->dl_period >
+                   (__uint128_t)(uint64)left * proc->dl_runtime )
+    dl_new_job( proc, now );
+}
+
+//
+// make proc (the current process) a deadline process: it gets runtime (rdtime units) of
+// processor time in every period, by deadline after the period starts. runtime 0 makes it
+// a best-effort process again. returns -1 if the parameters are invalid (runtime above
+// DL_RUNTIME_MAX, too), or the deadline class is out of bandwidth.
+//
+int sched_setdeadline( process* proc, uint64 runtime, uint64 deadline, uint64 period ) {
+  uint64 old_bw = dl_bw( proc->dl_runtime, proc->dl_period );
+
+  if( runtime == 0 ){
+    dl_total_bw -= old_bw;
+    proc->dl_runtime = proc->dl_deadline = proc->dl_period = 0;
+    timer_del( &proc->dl_timer );
+    return 0;
+  }
+
+  if( period == 0 ) period = deadline;
+  if( runtime > DL_RUNTIME_MAX || runtime > deadline || deadline > period ) return -1;
+
+  uint64 bw = dl_bw( runtime, period );
+  if( dl_total_bw - old_bw + bw > DL_BW_LIMIT ) return -1;
+  dl_total_bw += bw - old_bw;
+
+  proc->dl_runtime = runtime;
+  proc->dl_deadline = deadline;
+  proc->dl_period = period;
+  dl_new_job( proc, read_time() );
+  return 0;
+}
+
+//
+// select the scheduling policy given on the kernel command line.
+//
+void sched_init() {
+  char name[16];
+
+  if ( bootarg_get( "sched", name, sizeof(name) ) ){
+    for( int i = 0; i < ARRAY_SIZE(sched_policies); i++ )
+      if( strcmp( name, sched_policies[i].name ) == 0 ) policy = &sched_policies[i];
+    if( strcmp( name, policy->name ) != 0 )
+      sprint( "unknown scheduler \"%s\", using %s.\n", name, policy->name );
+  }
+  sprint( "scheduler: %s\n", policy->name );
+}
+
+//
+// charge the time proc ran since its last update (measured with rdtime) to its runtime,
+// and to its virtual runtime scaled by its weight.
+//
+static void update_runtime( process* proc ) {
+  uint64 now = read_time();
+  uint64 delta = now - proc->exec_start;
+
+  proc->exec_start = now;
+  proc->sum_exec_runtime += delta;
+  proc->vruntime += delta * NICE_0_WEIGHT / proc->weight;
+  if( proc->dl_period ) proc->dl_budget -= delta;
+  group_charge( proc, delta );
+}
+
+//
+// cpu accounting. the time and cycles of a process are charged at each switch between user
+// mode and the kernel (acct_kernel_entry, acct_user_return), and at the switches between
+// processes on a hart (run, schedule). everything in between is user time, or system time,
+// respectively.
+//
+static void acct_charge( process* proc, uint64* time, uint64* cycles ) {
+  uint64 now = read_time(), cycle = read_cycle();
+
+  *time += now - proc->acct_time;
+  *cycles += cycle - proc->acct_cycle;
+  proc->acct_time = now;
+  proc->acct_cycle = cycle;
+}
+
+// proc trapped into the kernel: its user time ends. called by smode_trap_handler.
+void acct_kernel_entry( process* proc ) { acct_charge( proc, &proc->utime, &proc->ucycles ); }
+
+// proc leaves the kernel, back to user mode (switch_to) or switched out: its system time ends.
+void acct_user_return( process* proc ) { acct_charge( proc, &proc->stime, &proc->scycles ); }
+
+//
+// set the nice value (-20 .. 19) of process pid (0 for the current process).
+// returns the previous nice value, or NICE_NOPROC if there is no such process.
 //
 extern process procs[NPROC];
-void schedule() {
-  if ( !ready_queue_head ){
-    // by default, if there are no ready process, and all processes are in the status of
-    // FREE and ZOMBIE, we should shutdown the emulated RISC-V machine.
-    int should_shutdown = 1;
+int sched_setnice( int pid, int nice ) {
+  process* proc = pid == 0 ? current : NULL;
+
+  for( int i = 0; !proc && i < NPROC; i++ )
+    if( procs[i].status != FREE && procs[i].pid == pid ) proc = &procs[i];
+  if( !proc ) return NICE_NOPROC;
+
+  if( nice < NICE_MIN ) nice = NICE_MIN;
+  if( nice > NICE_MAX ) nice = NICE_MAX;
+
+  int old = proc->nice;
+  proc->nice = nice;
+  proc->weight = nice_to_weight[nice - NICE_MIN];
+  return old;
+}
+
+//
+// timer tick, charged to the running process. called from smode_trap_handler.
+//
+void sched_tick() {
+  ++ current->total_tick_count;
+  update_runtime( current );
+  // deadline processes are preempted by sched_check_preempt only.
+  if( !current->dl_period ) policy->tick( current );
+}
+
+//
+// tell whether a timer interrupt is (also) the periodic scheduler tick of this hart. the
+// timer may fire earlier for a kernel timer, and a tickless hart has no tick at all.
+//
+int sched_tick_due() {
+  int hart = cpuid();
+  uint64 now = read_time();
+
+  if( tickless[hart] || (int64)(now - next_tick[hart]) < 0 ) return 0;
+  next_tick[hart] += TIMER_INTERVAL;
+  if( (int64)(now - next_tick[hart]) >= 0 ) next_tick[hart] = now + TIMER_INTERVAL;
+  return 1;
+}
+
+//
+// set the timer of this hart before it leaves the kernel, or waits idle. the tick is only
+// needed to preempt the running process while others wait in its run queue; otherwise the
+// hart goes tickless, and its timer is set for the next kernel timer (if any).
+//
+void sched_program_timer() {
+  int hart = cpuid();
+  uint64 next = timer_next_expiry();
+  int periodic = current && this_rq()->nr_ready > 0;
+
+  if( periodic ){
+    if( tickless[hart] ) next_tick[hart] = read_time() + TIMER_INTERVAL;
+    if( next_tick[hart] < next ) next = next_tick[hart];
+  }
+  tickless[hart] = !periodic;
+
+  // a deadline process is throttled as soon as its runtime is used up, and so is a process
+  // when its group runs out of quota (as far as this hart can tell).
+  if( current ){
+    uint64 end = -1;
+    if( current->dl_period )
+      end = current->exec_start + current->dl_budget;
+    else if( current->group->quota )
+      end = current->exec_start + current->group->runtime_left;
+    if( end < next ) next = end;
+  }
+  timer_program( next );
+}
+
+//
+// current process gives up the processor.
+//
+void sched_yield() {
+  ++ current->nvcsw;
+  update_runtime( current );
+
+  // a deadline process is done with its job, and waits for the next period.
+  if( current->dl_period ){
+    dl_check_miss( current, current->exec_start );
+    dl_throttle( current, DL_DONE );
+  }
+
+  policy->yield( current );
+  insert_to_ready_queue( current );
+  schedule();
+}
+
+/* --- wait queues --- */
+
+static void wq_append( wait_queue* wq, process* proc ) {
+  proc->waiting_on = wq;
+  proc->wait_next = NULL;
+  proc->wait_prev = wq->tail;
+  if( wq->tail )
+    wq->tail->wait_next = proc;
+  else
+    wq->head = proc;
+  wq->tail = proc;
+}
+
+static void wq_remove( wait_queue* wq, process* proc ) {
+  if( proc->wait_prev )
+    proc->wait_prev->wait_next = proc->wait_next;
+  else
+    wq->head = proc->wait_next;
+  if( proc->wait_next )
+    proc->wait_next->wait_prev = proc->wait_prev;
+  else
+    wq->tail = proc->wait_prev;
+  proc->wait_next = proc->wait_prev = NULL;
+  proc->waiting_on = NULL;
+}
+
+//
+// block the current process on wq until wakeup(wq), and run another process. must be
+// called from a system call, and does not return: there is no kernel context to come back
+// to, so the system call is restarted (the ecall executed again) once the process runs.
+// the system call thus has to check its condition again, as sleep/wakeup loops do.
+// wq may be NULL for a sleep that only a timer ends (see sleep_on_timeout).
+//
+void sleep_on( wait_queue* wq ) {
+  process* proc = current;
+
+  proc->trapframe->epc -= 4;
+  ++ proc->nvcsw;
+  update_runtime( proc );
+  // blocking before the end of the slice counts as giving the processor up.
+  policy->yield( proc );
+
+  proc->status = BLOCKED;
+  if( wq ) wq_append( wq, proc );
+  schedule();
+}
+
+//
+// the deadline of a sleeping process has come: finish its system call with sleep_ret,
+// instead of restarting it.
+//
+static void sleep_timeout( ktimer* t ) {
+  process* proc = (process*)t->data;
+
+  if( proc->waiting_on ) wq_remove( proc->waiting_on, proc );
+  proc->trapframe->regs.a0 = proc->sleep_ret;
+  proc->trapframe->epc += 4;
+  insert_to_ready_queue( proc );
+}
+
+//
+// like sleep_on, but also wake up at deadline (in rdtime units), where the system call
+// returns timeout_ret. with wq == NULL only the deadline ends the sleep. returns right away
+// if the deadline has passed. a restarted system call arms the timer again, so deadlines
+// are absolute.
+//
+void sleep_on_timeout( wait_queue* wq, uint64 deadline, long timeout_ret ) {
+  process* proc = current;
+  if( (int64)(deadline - read_time()) <= 0 ) return;
+
+  proc->sleep_ret = timeout_ret;
+  proc->sleep_timer.func = sleep_timeout;
+  proc->sleep_timer.data = proc;
+  timer_add( &proc->sleep_timer, time_to_jiffy_up( deadline ) );
+
+  sleep_on( wq );
+}
+
+//
+// make all the processes blocked on wq ready to run.
+//
+void wakeup( wait_queue* wq ) {
+  while( wq->head ){
+    process* proc = wq->head;
+    wq_remove( wq, proc );
+    timer_del( &proc->sleep_timer );
+    insert_to_ready_queue( proc );
+  }
+}
 
+//
+// insert a process, proc, into the END of ready queue (of its priority level) on its hart.
+// an idle hart is woken up to steal it.
+//
+void insert_to_ready_queue( process* proc ) {
+  klog_debug( "going to insert process %d to ready queue.\n", proc->pid );
+  if( proc->on_queue ) return;  //already in queue
+
+  if( proc->dl_period ){
+    if( proc->status == BLOCKED && !proc->dl_throttled ) dl_wakeup( proc );
+    dl_enqueue( &run_queues[proc->cpu], proc );
+  } else {
+    policy->enqueue( &run_queues[proc->cpu], proc );
+  }
+  proc->status = READY;
+  proc->ready_since = read_time();
+
+  // the hart of proc may run another process without ticks, it has to start them again.
+  // a deadline process may have to preempt the process running there.
+  process* cur = g_current[proc->cpu];
+  if( proc->cpu != cpuid() && cur &&
+      ( tickless[proc->cpu] || ( proc->dl_period && dl_preempts( proc, cur ) ) ) )
+    send_ipi( proc->cpu, IPI_RESCHED );
+
+  for( int hart = 0; hart < NCPU; hart++ )
+    if( hart != cpuid() && g_cpu_online[hart] && !g_current[hart] ){
+      send_ipi( hart, IPI_RESCHED );
+      break;
+    }
+}
+
+//
+// a process of a group that spent its quota waits for the next period (see group.c).
+//
+static void group_park( process* proc ) {
+  group_set_throttled( proc->group );
+  proc->status = BLOCKED;
+  wq_append( &proc->group->throttled_wq, proc );
+}
+
+//
+// take the next process of rq: deadline processes first, then the policy's. processes of
+// throttled groups are parked on the way.
+//
+static process* rq_pick( run_queue* rq ) {
+  process* proc;
+
+  while( ( proc = rq->dl_head ? dl_dequeue( rq ) : policy->dequeue( rq ) ) &&
+         group_over_quota( proc ) )
+    group_park( proc );
+  return proc;
+}
+
+//
+// the number of processes running or ready to run, on all harts (the load of the system).
+//
+int sched_nr_running() {
+  int n = 0;
+  for (int i = 0; i < NCPU; i++) n += run_queues[i].nr_ready + (g_current[i] != NULL);
+  return n;
+}
+
+//
+// tell whether the current process has to give up the hart before it goes back to user
+// mode: a deadline process that used up its runtime, a process whose group spent its quota,
+// or any process when a ready deadline process is due earlier.
+//
+int sched_preempt_pending() {
+  process* proc = current;
+  run_queue* rq = this_rq();
+
+  update_runtime( proc );
+  if( proc->dl_period ){
+    dl_check_miss( proc, proc->exec_start );
+    if( proc->dl_budget <= 0 ) return 1;
+  } else if( group_over_quota( proc ) ){
+    return 1;
+  }
+  return rq->dl_head && dl_preempts( rq->dl_head, proc );
+}
+
+//
+// called before the current process goes back to user mode: throttle or preempt it if
+// sched_preempt_pending says so.
+//
+void sched_check_preempt() {
+  process* proc = current;
+
+  if( !sched_preempt_pending() ) return;
+  if( proc->dl_period && proc->dl_budget <= 0 ) dl_throttle( proc, DL_OVERRUN );
+  if( group_over_quota( proc ) ){
+    ++ proc->nivcsw;
+    group_park( proc );
+    schedule();
+  }
+  preempt( proc );
+}
+
+//
+// take the next process to run: from the queue of this hart, or else from the busiest
+// queue of the other harts.
+//
+static process* pick_next() {
+  process* next = rq_pick( this_rq() );
+  if ( next ) return next;
+
+  run_queue* busiest = NULL;
+  for( int hart = 0; hart < NCPU; hart++ ){
+    run_queue* rq = &run_queues[hart];
+    if( rq->nr_ready > 0 && ( !busiest || rq->nr_ready > busiest->nr_ready ) ) busiest = rq;
+  }
+  return busiest ? rq_pick( busiest ) : NULL;
+}
+
+//
+// put next to run on this hart. does not return.
+//
+static void run( process* next ) {
+  current = next;
+  assert( current->status == READY );
+
+  current->status = RUNNING;
+  current->cpu = cpuid();
+  current->exec_start = read_time();
+  // the process stops waiting, and the kernel now works for it until it returns to user mode.
+  current->wait_time += current->exec_start - current->ready_since;
+  current->acct_time = current->exec_start;
+  current->acct_cycle = read_cycle();
+  klog_debug( "going to schedule process %d to run.\n", current->pid );
+  switch_to( current );
+}
+
+//
+// loop of a hart that has nothing to run, entered (on the idle stack) with the kernel lock
+// held. the lock is released while the hart waits for an interrupt: its timer (set for the
+// next kernel timer only), or an IPI_RESCHED when a process is queued (see
+// insert_to_ready_queue).
+//
+static void cpu_idle() {
+  for( ;; ){
+    process* next = pick_next();
+    if( next ) run( next );
+
+    // if all processes are in the status of FREE and ZOMBIE, we should shutdown the
+    // emulated RISC-V machine.
+    int should_shutdown = 1;
     for( int i=0; i<NPROC; i++ )
-      if( (procs[i].status != FREE) && (procs[i].status != ZOMBIE) ){
-        should_shutdown = 0;
-        sprint( "ready queue empty, but process %d is not in free/zombie state:%d\n", 
-          i, procs[i].status );
-      }
+      if( (procs[i].status != FREE) && (procs[i].status != ZOMBIE) ) should_shutdown = 0;
 
     if( should_shutdown ){
+      klog_drain();
       sprint( "no more ready processes, system shutdown now.\n" );
       shutdown( 0 );
-    }else{
-      panic( "Not handled: we should let system wait for unfinished processes.\n" );
     }
+
+    // the hart has time to spare: print the kernel log, and what is left in its console
+    // buffer.
+    klog_drain();
+    console_flush();
+    sched_program_timer();
+    kernel_unlock();
+    while( !(read_csr(sip) & (SIP_SSIP | SIP_STIP)) )
+      asm volatile( "wfi" );
+    kernel_lock();
+
+    uint64 pending = take_ipi();
+    if( read_csr(sip) & SIP_STIP ){
+      timer_program( -1 );
+      pending |= IPI_TIMER;
+    }
+    if( pending & IPI_TIMER ) handle_mtimer_trap();
   }
+}
 
-  current = ready_queue_head;
-  assert( current->status == READY );
-  ready_queue_head = ready_queue_head->queue_next;
+//
+// choose a proc from the ready queue, and put it to run.
+// note: schedule() does not take care of previous current process. If the current
+// process is still runnable, you should place it into the ready queue (by calling
+// ready_queue_insert), and then call schedule().
+//
+void schedule() {
+  // the outgoing process (if any) stops accumulating runtime and system time now.
+  if ( current ){
+    update_runtime( current );
+    acct_user_return( current );
+  }
 
-  current->status == RUNNING;
-  sprint( "going to schedule process %d to run.\n", current->pid );
-  switch_to( current );
+  process* next = pick_next();
+  if ( next ) run( next );
+
+  // nothing to run. leave the kernel stack of the outgoing process first: it may be freed
+  // (do_wait), or used by the process on another hart, once the kernel lock is released.
+  // the same holds for its floating point and vector registers.
+  fpu_release();
+  current = NULL;
+  // with shared kernel mappings the hart may still run on the page table of the outgoing
+  // process, which is freed when it is reaped.
+  if( g_kmap_shared ){
+    write_csr( satp, MAKE_SATP( g_kernel_pagetable ) );
+    flush_tlb();
+  }
+  asm volatile( "mv sp, %0\n\tjr %1" : : "r"(&idle_stack[cpuid()][PGSIZE]), "r"(cpu_idle) );
 }
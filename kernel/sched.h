@@ -6,7 +6,90 @@
 //length of a time slice, in number of ticks
 #define TIME_SLICE_LEN  2
 
+// number of priority levels in the ready queue, 0 is the highest priority
+#define NPRIO 8
+// priority given to new processes
+#define DEFAULT_PRIO 0
+
+//
+// the ready queue: one FIFO list (with head and tail) per priority level, plus a bitmap of
+// the non-empty levels. insertion, removal and picking the next process are all O(1).
+//
+typedef struct run_queue {
+  process *head[NPRIO];
+  process *tail[NPRIO];
+  uint32 bitmap;    // bit i is set if level i is not empty
+
+  // min-heap of processes ordered by virtual runtime, used by the cfs policy
+  process *heap[NPROC];
+  int heap_size;
+  uint64 min_vruntime;  // monotonic lower bound of the virtual runtimes in the heap
+
+  // ready deadline processes, by absolute deadline (linked by queue_next). they run ahead
+  // of the processes of the policy.
+  process *dl_head;
+
+  uint64 last_boost;  // g_ticks at the last MLFQ boost of this queue
+  int nr_ready;     // number of processes in the queue
+} run_queue;
+
+// number of MLFQ levels in use (at most NPRIO)
+#define MLFQ_LEVELS 4
+// interval (in ticks) at which MLFQ moves every process back to the top level
+#define MLFQ_BOOST_INTERVAL 50
+
+// nice values of the cfs policy, and the weight of nice 0
+#define NICE_MIN -20
+#define NICE_MAX 19
+// what sched_setnice returns if there is no such process: not a nice value, unlike -1
+#define NICE_NOPROC (NICE_MIN - 1)
+#define NICE_0_WEIGHT 1024
+// virtual runtime lead (in rdtime units) after which cfs preempts the running process
+#define CFS_GRANULARITY (TIMER_INTERVAL / 2)
+
+// the deadline class admits processes as long as their total bandwidth (runtime / period,
+// in units of 1 / DL_BW_UNIT) stays below DL_BW_LIMIT, 95% of all harts.
+#define DL_BW_SHIFT 20
+#define DL_BW_UNIT (1UL << DL_BW_SHIFT)
+#define DL_BW_LIMIT (NCPU * DL_BW_UNIT * 95 / 100)
+// the largest runtime (rdtime units) whose bandwidth can be computed in 64 bits
+#define DL_RUNTIME_MAX (~0UL >> DL_BW_SHIFT)
+
+// reasons a deadline process waits for its next period (dl_throttled)
+#define DL_OVERRUN 1  // used up its runtime
+#define DL_DONE 2     // finished its job (yield)
+
+//
+// a scheduling policy, selected at boot time (see sched_init).
+//
+typedef struct sched_policy {
+  const char *name;
+  // queue proc as ready / remove and return the next process to run
+  void (*enqueue)(run_queue *rq, process *proc);
+  process *(*dequeue)(run_queue *rq);
+  // timer tick charged to the running process, may preempt it
+  void (*tick)(process *proc);
+  // proc gives up the processor before it is preempted
+  void (*yield)(process *proc);
+} sched_policy;
+
+void sched_init();
+void sched_tick();
+int sched_tick_due();
+void sched_program_timer();
+void sched_yield();
+int sched_setnice( int pid, int nice );
+int sched_setdeadline( process* proc, uint64 runtime, uint64 deadline, uint64 period );
+int sched_preempt_pending();
+int sched_nr_running();
+void sched_check_preempt();
+void acct_kernel_entry( process* proc );
+void acct_user_return( process* proc );
 void insert_to_ready_queue( process* proc );
 void schedule();
 
+void sleep_on( wait_queue* wq );
+void sleep_on_timeout( wait_queue* wq, uint64 deadline, long timeout_ret );
+void wakeup( wait_queue* wq );
+
 #endif
@@ -0,0 +1,61 @@
+/*
+ * multi-hart support: the big kernel lock, inter-processor interrupts and tlb shootdown.
+ *
+ * all the harts run the kernel under one lock, taken at the kernel entry (smode_trap_handler
+ * or s_start) and released by return_to_user right before the hart goes back to user mode,
+ * or by an idle hart while it waits for work. user processes run in parallel.
+ */
+
+#include "smp.h"
+#include "memlayout.h"
+#include "process.h"
+#include "spike_interface/spike_utils.h"
+
+volatile uint64 g_ipi_pending[NCPU];
+volatile int g_cpu_online[NCPU];
+volatile int g_cpu_in_user[NCPU];
+volatile int g_tlb_stale[NCPU];
+
+ticketlock_t g_kernel_lock = TICKETLOCK_INIT;
+
+void kernel_lock() { ticket_lock(&g_kernel_lock); }
+
+void kernel_unlock() { ticket_unlock(&g_kernel_lock); }
+
+//
+// post reason to hartid, and raise a machine software interrupt there. the M-mode handler
+// (see mtrap.c) turns it into a supervisor software interrupt.
+//
+void send_ipi(int hartid, uint64 reason) {
+  atomic_or(&g_ipi_pending[hartid], reason);
+  mb();
+  *(volatile uint32 *)KERN_CLINT_MSIP(hartid) = 1;
+}
+
+//
+// acknowledge the supervisor software interrupt, and return the reasons posted since the
+// last call. a reason posted after the sip bit is cleared raises it again, so none is lost.
+//
+uint64 take_ipi() {
+  write_csr(sip, read_csr(sip) & ~SIP_SSIP);
+  return atomic_swap(&g_ipi_pending[cpuid()], 0);
+}
+
+//
+// make the other harts drop their tlb entries of pagetable after it was changed.
+// the caller holds the kernel lock, so a hart found in user mode cannot come back to user
+// mode until we are done. its trap vector flushes the tlb before it enters the kernel and
+// clears g_cpu_in_user, which is what we wait for. with shared kernel mappings the trap
+// vector keeps the user page table, and the harts flush on their way back to user mode.
+//
+void tlb_shootdown(pagetable_t pagetable) {
+  for (int hart = 0; hart < NCPU; hart++) {
+    if (!g_current[hart] || g_current[hart]->pagetable != pagetable) continue;
+    g_tlb_stale[hart] = 1;
+    if (hart == cpuid() || !g_cpu_in_user[hart]) continue;
+
+    send_ipi(hart, IPI_TLB_FLUSH);
+    while (g_cpu_in_user[hart])
+      ;
+  }
+}
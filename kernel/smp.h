@@ -0,0 +1,44 @@
+#ifndef _SMP_H_
+#define _SMP_H_
+
+#include "riscv.h"
+#include "config.h"
+#include "spike_interface/atomic.h"
+
+//
+// reasons of an inter-processor interrupt, posted in g_ipi_pending[hartid]. all of them
+// arrive as a supervisor software interrupt (SSIP).
+//
+#define IPI_TIMER     (1L << 0)  // timer tick of the hart, posted by M-mode (see mtrap.c)
+#define IPI_RESCHED   (1L << 1)  // new work in the run queues, sent to idle harts
+#define IPI_TLB_FLUSH (1L << 2)  // a page table the hart is running on was changed
+
+// pending ipi reasons of each hart
+extern volatile uint64 g_ipi_pending[NCPU];
+// set for each hart that has entered the S-mode scheduler
+extern volatile int g_cpu_online[NCPU];
+// set while a hart runs in user mode (cleared at the kernel entry, after the tlb flush)
+extern volatile int g_cpu_in_user[NCPU];
+
+// set for each hart that has to flush its tlb before it returns to user mode, where the
+// return does not switch satp (shared kernel mappings, see g_kmap_shared in vmm.c)
+extern volatile int g_tlb_stale[NCPU];
+
+// the big kernel lock, held by a hart from the kernel entry to return_to_user. a ticket
+// lock, so that a hart coming back from idle is not starved by busy ones.
+extern ticketlock_t g_kernel_lock;
+
+// the hart we are running on (kept in tp while in S-mode, see strap_vector.S)
+static inline int cpuid() { return read_tp(); }
+
+void kernel_lock();
+void kernel_unlock();
+
+// a user page table of this hart was changed
+static inline void tlb_mark_stale() { g_tlb_stale[cpuid()] = 1; }
+
+void send_ipi(int hartid, uint64 reason);
+uint64 take_ipi();
+void tlb_shootdown(pagetable_t pagetable);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _SPAWN_H_
+#define _SPAWN_H_
+
+#include "util/types.h"
+
+// most file actions of one spawn
+#define SPAWN_ACTIONS_MAX 16
+
+// what a file action does to the descriptor table the child inherits from its parent
+#define SPAWN_END 0    // end of the list
+#define SPAWN_CLOSE 1  // the child does not get fd
+#define SPAWN_DUP2 2   // the child gets the parent's fd as newfd as well
+
+//
+// one file action of spawn. the list ends with SPAWN_END, or after SPAWN_ACTIONS_MAX.
+//
+struct spawn_action {
+  int op;
+  int fd;
+  int newfd;  // SPAWN_DUP2 only
+};
+
+#endif
@@ -9,6 +9,10 @@
 #include "pmm.h"
 #include "vmm.h"
 #include "sched.h"
+#include "ksm.h"
+#include "fpu.h"
+#include "smp.h"
+#include "klog.h"
 #include "util/functions.h"
 
 #include "spike_interface/spike_utils.h"
@@ -30,16 +34,73 @@ static void handle_syscall(trapframe *tf) {
 
 }
 
+//
+// the fast path of the system calls listed in syscall_fast, entered from smode_trap_vector
+// with only the registers saved that C code may clobber. returns the satp for the way back
+// to user mode (0: keep it), or -1 if the process has to be switched out first: the trap
+// vector then saves the other registers, and leaves through smode_syscall_slow_exit.
+//
+uint64 smode_syscall_fast(trapframe *tf) {
+  g_cpu_in_user[cpuid()] = 0;
+  acct_kernel_entry(current);
+  kernel_lock();
+
+  tf->epc = read_csr(sepc);
+  handle_syscall(tf);
+
+  if (sched_preempt_pending()) return -1;
+  write_csr(sepc, tf->epc);
+  return prepare_return(current);
+}
+
+//
+// the rest of a fast system call that has to switch processes.
+//
+void smode_syscall_slow_exit(void) {
+  sched_check_preempt();
+  switch_to(current);
+}
+
 //
 // global variable that store the recorded "ticks"
 uint64 g_ticks = 0;
 void handle_mtimer_trap() {
-  sprint("Ticks %d\n", g_ticks);
-  // TODO (lab1_3): increase g_ticks to record this "tick", and then clear the "SIP"
-  // field in sip register.
-  // hint: use write_csr to disable the SIP_SSIP bit in sip.
-  ++g_ticks;
-  write_csr(sip, read_csr(sip) & ~SIP_SSIP);
+  // the sip bit was cleared by take_ipi().
+  uint64 now = read_time();
+
+  // a partial line of console output waits at most until the next timer interrupt.
+  console_flush();
+
+  // expire the kernel timers (sleeps and timeouts).
+  timer_run(time_to_jiffy(now));
+
+  // the timers of the harts do not fire at every tick any more (see sched_program_timer),
+  // g_ticks follows the time instead. the periodic scans run at the first timer interrupt
+  // of any hart after they are due.
+  uint64 ticks = (now - g_boot_time) / TIMER_INTERVAL;
+  if ( ticks <= g_ticks ) return;
+  uint64 prev = g_ticks;
+  g_ticks = ticks;
+
+  // print the kernel log messages of the last tick, in one batch.
+  klog_drain();
+
+  // periodically merge identical anonymous pages. runs before the aging scan, which clears
+  // the dirty bits that tell recently written pages apart.
+  if ( KSM_SCAN_INTERVAL && ticks / KSM_SCAN_INTERVAL != prev / KSM_SCAN_INTERVAL )
+    ksm_scan();
+
+  // periodically sample the accessed/dirty bits of user pages.
+  if ( ticks / WSS_SCAN_INTERVAL != prev / WSS_SCAN_INTERVAL )
+    age_working_sets();
+}
+
+//
+// a timer interrupt of this hart: kernel timers, and the scheduler tick if it is due.
+//
+static void handle_timer_interrupt() {
+  handle_mtimer_trap();
+  if ( sched_tick_due() ) sched_tick();
 }
 
 //
@@ -48,7 +109,17 @@ void handle_mtimer_trap() {
 // stval: the virtual address that causes pagefault when being accessed.
 //
 void handle_user_page_fault(uint64 mcause, uint64 sepc, uint64 stval) {
-  sprint("handle_page_fault: %lx\n", stval);
+  // user mappings start with clear accessed/dirty bits (see prot_to_type), so the first
+  // access to a valid page lands here. only the missing bit needs to be set.
+  if (user_vm_access_fault(current->pagetable, stval, mcause)) return;
+
+  // a write to a merged page (see ksm.c) gets a private copy of the page.
+  if (mcause == CAUSE_STORE_PAGE_FAULT && user_vm_cow_fault(current->pagetable, stval)) {
+    ksm_stat.cow_breaks++;
+    return;
+  }
+
+  klog_debug("handle_page_fault: %lx\n", stval);
   switch (mcause) {
     case CAUSE_STORE_PAGE_FAULT:
       // TODO (lab2_3): implement the operations that solve the page fault to
@@ -62,28 +133,11 @@ void handle_user_page_fault(uint64 mcause, uint64 sepc, uint64 stval) {
       }
       break;
     default:
-      sprint("unknown page fault.\n");
+      klog_warn("unknown page fault.\n");
       break;
   }
 }
 
-//
-// implements round-robin scheduling
-//
-void rrsched() {
-  // TODO (lab3_3): implements round-robin scheduling.
-  // hint: increase the tick_count member of current process by one, if it is bigger than
-  // TIME_SLICE_LEN (means it has consumed its time slice), change its status into READY,
-  // place it in the rear of ready queue, and finally schedule next process to run.
-  ++ current->tick_count;
-  ++ current->total_tick_count;
-  if ( current->tick_count >= TIME_SLICE_LEN ){
-    current->tick_count = 0;
-    insert_to_ready_queue(current);
-    schedule();
-  }
-}
-
 //
 // kernel/smode_trap.S will pass control to smode_trap_handler, when a trap happens
 // in S-mode.
@@ -93,6 +147,13 @@ void smode_trap_handler(void) {
   // we will consider other previous case in lab1_3 (interrupt).
   if ((read_csr(sstatus) & SSTATUS_SPP) != 0) panic("usertrap: not from user mode");
 
+  // the trap vector has flushed the tlb (unless kmap=shared, see tlb_shootdown), and
+  // loaded tp.
+  g_cpu_in_user[cpuid()] = 0;
+  // the wait for the kernel lock is system time already.
+  acct_kernel_entry(current);
+  kernel_lock();
+
   assert(current);
   // save user process counter.
   current->trapframe->epc = read_csr(sepc);
@@ -104,9 +165,17 @@ void smode_trap_handler(void) {
     case CAUSE_USER_ECALL:
       handle_syscall(current->trapframe);
       break;
-    case CAUSE_MTIMER_S_TRAP:
-      handle_mtimer_trap();
-      rrsched();
+    case CAUSE_MTIMER_S_TRAP: {
+      // the supervisor software interrupt carries both the timer tick and the IPIs. a tlb
+      // flush is already done, and a reschedule request only matters to idle harts.
+      uint64 pending = take_ipi();
+      if ( pending & IPI_TIMER ) handle_timer_interrupt();
+      break;
+    }
+    case CAUSE_STIMER_S_TRAP:
+      // Sstc: the timer comes to S-mode directly. turn it off until it is set again.
+      timer_program(-1);
+      handle_timer_interrupt();
       break;
     case CAUSE_STORE_PAGE_FAULT:
     case CAUSE_LOAD_PAGE_FAULT:
@@ -114,6 +183,18 @@ void smode_trap_handler(void) {
       // call handle_user_page_fault to process page faults
       handle_user_page_fault(cause, read_csr(sepc), read_csr(stval));
       break;
+    case CAUSE_FETCH_PAGE_FAULT:
+      // only the first fetch from a mapped code page, which sets its accessed bit. a jump
+      // to an unmapped address would fault again and again.
+      if (user_vm_access_fault(current->pagetable, read_csr(stval), cause)) break;
+      sprint("smode_trap_handler(): instruction page fault at %p\n", read_csr(stval));
+      panic( "unexpected exception happened.\n" );
+      break;
+    case CAUSE_ILLEGAL_INSTRUCTION:
+      // the first floating point or vector instruction since the process came to this
+      // hart: the unit is turned on, and the instruction runs again.
+      if (fpu_trap(current, read_csr(stval))) break;
+      // fall through
     default:
       sprint("smode_trap_handler(): unexpected scause %p\n", read_csr(scause));
       sprint("            sepc=%p stval=%p\n", read_csr(sepc), read_csr(stval));
@@ -121,6 +202,9 @@ void smode_trap_handler(void) {
       break;
   }
 
-  // continue the execution of current process.
+  // a deadline process may have to make way for another one.
+  sched_check_preempt();
+
+  // continue the execution of current process. switch_to releases the kernel lock.
   switch_to(current);
 }
@@ -2,5 +2,6 @@
 #define _STRAP_H_
 
 void smode_trap_handler(void);
+void handle_mtimer_trap();
 
 #endif
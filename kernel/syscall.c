@@ -12,8 +12,13 @@
 #include "util/functions.h"
 #include "pmm.h"
 #include "vmm.h"
+#include "memlayout.h"
 #include "sched.h"
 #include "file.h"
+#include "group.h"
+#include "syscall_stat.h"
+#include "uio.h"
+#include "klog.h"
 
 #include "spike_interface/spike_utils.h"
 
@@ -25,6 +30,8 @@ ssize_t sys_user_print(const char* buf, size_t n) {
   //so we have to transfer it into phisical address (kernel is running in direct mapping).
   assert( current );
   char* pa = (char*)user_va_to_pa((pagetable_t)(current->pagetable), (void*)buf);
+  // the kernel messages that came before go out first.
+  klog_drain();
   sprint(pa);
   return 0;
 }
@@ -54,9 +61,13 @@ uint64 sys_user_allocate_page() {
 }
 
 //
-// reclaim a page, indicated by "va".
+// reclaim a page, indicated by "va": a heap page handed out by allocate_page. returns -1
+// for any other address, a kernel page (kmap=shared) above all.
 //
 uint64 sys_user_free_page(uint64 va) {
+  if (va % PGSIZE || va < USER_FREE_ADDRESS_START || va >= g_ufree_page ||
+      !user_va_to_pa((pagetable_t)current->pagetable, (void *)va))
+    return -1;
   user_vm_unmap((pagetable_t)current->pagetable, va, PGSIZE, 1);
   return 0;
 }
@@ -69,6 +80,14 @@ ssize_t sys_user_fork() {
   return do_fork( current );
 }
 
+//
+// kerenl entry point of vfork. the child gets a copy of the full trapframe, so vfork does
+// not take the fast path.
+//
+ssize_t sys_user_vfork() {
+  return do_vfork();
+}
+
 //
 // kerenl entry point of yield
 //
@@ -77,8 +96,7 @@ ssize_t sys_user_yield() {
   // hint: the functionality of yield is to give up the processor. therefore,
   // we should set the status of currently running process to READY, insert it in 
   // the rear of ready queue, and finally, schedule a READY process to run.
-  insert_to_ready_queue( current );
-  schedule();
+  sched_yield();
   return 0;
 }
 
@@ -86,27 +104,41 @@ ssize_t sys_user_yield() {
 // add kerenl entry point of wait
 //
 int sys_user_wait(int pid){
-  return do_wait(pid);
+  return do_wait(pid, 0);
+}
+
+//
+// wait with a timeout. deadline is absolute (ns since boot), so that the system call can
+// be restarted after a wakeup. returns -2 if no child exited before the deadline. a
+// deadline of 0 only polls.
+//
+int sys_user_wait_timeout(int pid, uint64 deadline_ns){
+  return do_wait(pid, deadline_ns ? g_boot_time + ns_to_time(deadline_ns) : 1);
 }
 
 //
 // implement the SYS_user_getline syscall
 //
 ssize_t sys_user_getline(char * dst, int size) {
-  //buf is an address in user space on user stack,
-  //so we have to transfer it into phisical address (kernel is running in direct mapping).
+  //buf is an address in user space on user stack, the line is read into a kernel page
+  //first, and copied out (see copy_to_user).
   assert( current );
-  char* pa = (char*)user_va_to_pa((pagetable_t)(current->pagetable), (void*)dst);
-  sgetline(pa, size);
-  return 0;
+  if (size <= 0) return -1;
+  if (size > PGSIZE) size = PGSIZE;
+  char* line = (char*)alloc_page();
+  sgetline(line, size);
+  int r = copy_to_user((pagetable_t)(current->pagetable), (uint64)dst, line, strlen(line) + 1);
+  free_page(line);
+  return r;
 }
 
 //
-// implement the SYS_user_exec syscall
+// implement the SYS_user_exec syscall. the return value is the a0 of the new program: its
+// argc, set up by the loader.
 //
 ssize_t sys_user_exec(char * path, char ** argv) {
   do_exec(path, argv);
-  return 0;
+  return current->trapframe->regs.a0;
 }
 
 //
@@ -124,10 +156,12 @@ ssize_t sys_user_read(int fd, char *bufva, uint64 count) {
   int i = 0;
   while (i < count) { // count can be greater than page size
     uint64 addr = (uint64)bufva + i;
-    uint64 pa = lookup_pa((pagetable_t)current->pagetable, addr);
     uint64 off = addr - ROUNDDOWN(addr, PGSIZE);
     uint64 len = count - i < PGSIZE - off ? count - i : PGSIZE - off;
-    uint64 r = do_read(fd, (char *)pa + off, len);
+    char *pa = (char *)user_va_to_pa_writable((pagetable_t)current->pagetable, (void *)addr);
+    if (!pa) return i ? i : -1;
+    int64 r = do_read(fd, pa, len);
+    if (r < 0) return i ? i : -1;
     i += r; if (r < len) return i;
   }
   return count;
@@ -140,15 +174,92 @@ ssize_t sys_user_write(int fd, char *bufva, uint64 count) {
   int i = 0;
   while (i < count) { // count can be greater than page size
     uint64 addr = (uint64)bufva + i;
-    uint64 pa = lookup_pa((pagetable_t)current->pagetable, addr);
     uint64 off = addr - ROUNDDOWN(addr, PGSIZE);
     uint64 len = count - i < PGSIZE - off ? count - i : PGSIZE - off;
-    uint64 r = do_write(fd, (char *)pa + off, len);
+    // only user pages: with kmap=shared the kernel is mapped into the table as well.
+    char *pa = (char *)user_va_to_pa((pagetable_t)current->pagetable, (void *)addr);
+    if (!pa) return i ? i : -1;
+    int64 r = do_write(fd, pa, len);
+    if (r < 0) return i ? i : -1;
     i += r; if (r < len) return i;
   }
   return count;
 }
 
+//
+// scatter/gather i/o: the common part of readv, writev, preadv and pwritev (off < 0 for
+// the file position). the iovec array is walked once; its buffers are split at page
+// boundaries, and physically contiguous pages are merged again, so that a buffer that is
+// contiguous in memory goes to the file in one piece.
+//
+static ssize_t sys_user_rwv(int fd, struct iovec *iovva, int iovcnt, int64 off, int write) {
+  pagetable_t pt = (pagetable_t)current->pagetable;
+  struct kiov kiov[KIOV_MAX];
+  ssize_t done = 0;
+  uint64 want = 0;
+  int n = 0;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX) return -1;
+  for (int i = 0; i < iovcnt; i++) {
+    // the two fields of an entry may be on different pages.
+    uint64 *basep = (uint64 *)user_va_to_pa(pt, &iovva[i].iov_base);
+    uint64 *lenp = (uint64 *)user_va_to_pa(pt, &iovva[i].iov_len);
+    if (!basep || !lenp) return -1;
+
+    for (uint64 va = *basep, end = *basep + *lenp; va < end;) {
+      uint64 len = ROUNDDOWN(va, PGSIZE) + PGSIZE - va;
+      if (len > end - va) len = end - va;
+      // a read stores to the page (see user_va_to_pa_writable).
+      char *pa = (char *)(write ? user_va_to_pa(pt, (void *)va) : user_va_to_pa_writable(pt, (void *)va));
+      if (!pa) return done ? done : -1;
+
+      if (n > 0 && kiov[n - 1].base + kiov[n - 1].len == pa) {
+        kiov[n - 1].len += len;
+      } else {
+        if (n == KIOV_MAX) {
+          // out of pieces: move what there is, and go on if it all went.
+          int r = do_rwv(fd, kiov, n, off < 0 ? off : off + done, write);
+          if (r < 0) return done ? done : -1;
+          done += r;
+          if (r < want) return done;
+          n = 0;
+          want = 0;
+        }
+        kiov[n].base = pa;
+        kiov[n++].len = len;
+      }
+      want += len;
+      va += len;
+    }
+  }
+  if (n == 0) return done;
+
+  int r = do_rwv(fd, kiov, n, off < 0 ? off : off + done, write);
+  if (r < 0) return done ? done : -1;
+  return done + r;
+}
+
+ssize_t sys_user_readv(int fd, struct iovec *iov, int iovcnt) {
+  return sys_user_rwv(fd, iov, iovcnt, -1, 0);
+}
+
+ssize_t sys_user_writev(int fd, struct iovec *iov, int iovcnt) {
+  return sys_user_rwv(fd, iov, iovcnt, -1, 1);
+}
+
+//
+// positional variants: at offset off of the file, which keeps its position.
+//
+ssize_t sys_user_preadv(int fd, struct iovec *iov, int iovcnt, int64 off) {
+  if (off < 0) return -1;
+  return sys_user_rwv(fd, iov, iovcnt, off, 0);
+}
+
+ssize_t sys_user_pwritev(int fd, struct iovec *iov, int iovcnt, int64 off) {
+  if (off < 0) return -1;
+  return sys_user_rwv(fd, iov, iovcnt, off, 1);
+}
+
 //
 // close file
 //
@@ -168,11 +279,229 @@ ssize_t sys_user_getinfo() {
   return do_getinfo();
 }
 
+//
+// set the nice value (scheduling weight) of a process, pid 0 means the caller
+//
+ssize_t sys_user_nice(int pid, int nice) {
+  return sched_setnice(pid, nice);
+}
+
+//
+// sleep for ns nanoseconds
+//
+ssize_t sys_user_nanosleep(uint64 ns) {
+  sleep_on_timeout(NULL, read_time() + ns_to_time(ns), 0);
+  return 0;
+}
+
+//
+// sleep until deadline_ns (ns since boot)
+//
+ssize_t sys_user_sleep_until(uint64 deadline_ns) {
+  sleep_on_timeout(NULL, g_boot_time + ns_to_time(deadline_ns), 0);
+  return 0;
+}
+
+//
+// time since boot, in ns
+//
+ssize_t sys_user_gettime() {
+  return time_to_ns(read_time() - g_boot_time);
+}
+
+//
+// implement the SYS_user_getstat syscall: copy the cpu accounting of process pid (0 for
+// the calling process) to st, in user space.
+//
+ssize_t sys_user_getstat(int pid, struct proc_stat* st) {
+  struct proc_stat kst;
+  if (do_getstat(pid, &kst) < 0) return -1;
+  return copy_to_user((pagetable_t)(current->pagetable), (uint64)st, &kst, sizeof(kst));
+}
+
+//
+// implement the SYS_user_sched_deadline syscall: make the calling process a deadline
+// process (runtime 0 makes it best-effort again). times are in nanoseconds.
+//
+ssize_t sys_user_sched_deadline(uint64 runtime_ns, uint64 deadline_ns, uint64 period_ns) {
+  return sched_setdeadline(current, ns_to_time(runtime_ns), ns_to_time(deadline_ns),
+                           ns_to_time(period_ns));
+}
+
+//
+// implement the SYS_user_group_create syscall: a cpu group whose processes may run for
+// quota_ns in every period_ns (quota_ns 0: no limit). returns the group id, or -1.
+//
+ssize_t sys_user_group_create(uint64 quota_ns, uint64 period_ns) {
+  return group_create(ns_to_time(quota_ns), ns_to_time(period_ns));
+}
+
+//
+// implement the SYS_user_group_join syscall: move the calling process to group id
+//
+ssize_t sys_user_group_join(int id) {
+  return group_join(id);
+}
+
+//
+// implement the SYS_user_group_stat syscall: copy the usage of group id to st
+//
+ssize_t sys_user_group_stat(int id, struct group_stat* st) {
+  struct group_stat kst;
+  if (group_getstat(id, &kst) < 0) return -1;
+  return copy_to_user((pagetable_t)(current->pagetable), (uint64)st, &kst, sizeof(kst));
+}
+
+//
+// implement the SYS_user_getpid syscall
+//
+ssize_t sys_user_getpid() {
+  return current->pid;
+}
+
+//
+// implement the SYS_user_uring_setup syscall: map the submission/completion rings of the
+// calling process. returns their address, or 0 if they exist already.
+//
+ssize_t sys_user_uring_setup() {
+  return do_uring_setup();
+}
+
+//
+// implement the SYS_user_uring_enter syscall: run up to to_submit queued operations
+//
+ssize_t sys_user_uring_enter(int to_submit) {
+  return do_uring_enter(to_submit);
+}
+
+#ifdef SYSCALL_STATS
+extern process procs[NPROC];
+
+// counters of all processes, dead ones included
+static struct syscall_stat syscall_stats[SYSCALL_STAT_NR];
+
+//
+// histogram bucket of a call that took cycles.
+//
+static inline int syscall_hist_bucket(uint64 cycles) {
+  int log2 = 0;
+  for (int shift = 32; shift; shift >>= 1)
+    if (cycles >> shift) {
+      cycles >>= shift;
+      log2 += shift;
+    }
+  if (log2 < SYSCALL_HIST_SHIFT) return 0;
+  if (log2 >= SYSCALL_HIST_SHIFT + SYSCALL_HIST_BUCKETS) return SYSCALL_HIST_BUCKETS - 1;
+  return log2 - SYSCALL_HIST_SHIFT;
+}
+
+static inline void syscall_stat_add(struct syscall_stat *st, long ret, uint64 cycles, int b) {
+  st->calls++;
+  st->errors += ret < 0;
+  st->cycles += cycles;
+  st->hist[b]++;
+}
+#endif
+
+//
+// implement the SYS_user_syscall_stat syscall: copy the counters of system call nr (an
+// offset from SYS_user_base) of process pid to st. pid 0 is the calling process, -1 stands
+// for all processes. returns -1 if there is no such process or call, or if the kernel does
+// not keep the counters.
+//
+ssize_t sys_user_syscall_stat(int pid, int nr, struct syscall_stat *st) {
+#ifdef SYSCALL_STATS
+  struct syscall_stat *table = pid == -1 ? syscall_stats : NULL;
+  if (nr < 0 || nr >= SYSCALL_STAT_NR) return -1;
+
+  if (pid == 0) table = current->syscall_stats;
+  for (int i = 0; !table && pid > 0 && i < NPROC; i++)
+    if (procs[i].status != FREE && procs[i].pid == pid) table = procs[i].syscall_stats;
+  if (!table) return -1;
+
+  return copy_to_user((pagetable_t)(current->pagetable), (uint64)st, &table[nr], sizeof(*st));
+#else
+  return -1;
+#endif
+}
+
+//
+// implement the SYS_user_spawn syscall: start program path (a shell command) with the
+// arguments argv in a new child, and the file actions acts (may be NULL) applied to the
+// files it inherits. returns the pid of the child, or -1.
+//
+ssize_t sys_user_spawn(char *pathva, char **argv, struct spawn_action *acts) {
+  pagetable_t pt = (pagetable_t)current->pagetable;
+  struct spawn_action kacts[SPAWN_ACTIONS_MAX];
+  int n = 0;
+
+  char *path = (char *)user_va_to_pa(pt, pathva);
+  if (!path) return -1;
+  // an entry may straddle two pages, its fields are read one by one.
+  for (; acts && n < SPAWN_ACTIONS_MAX; n++) {
+    int *op = (int *)user_va_to_pa(pt, &acts[n].op);
+    int *fd = (int *)user_va_to_pa(pt, &acts[n].fd);
+    int *newfd = (int *)user_va_to_pa(pt, &acts[n].newfd);
+    if (!op || !fd || !newfd) return -1;
+    if (*op == SPAWN_END) break;
+    kacts[n].op = *op;
+    kacts[n].fd = *fd;
+    kacts[n].newfd = *newfd;
+  }
+  return do_spawn(path, argv, kacts, n);
+}
+
+//
+// implement the SYS_user_dmesg syscall: copy the text of the kernel log (at most len bytes,
+// and a page) to buf. returns the number of bytes.
+//
+ssize_t sys_user_dmesg(char *buf, uint64 len) {
+  char *text = (char *)alloc_page();
+  int n = klog_read(text, len < PGSIZE ? len : PGSIZE);
+
+  if (copy_to_user((pagetable_t)(current->pagetable), (uint64)buf, text, n) < 0) n = -1;
+  free_page(text);
+  return n;
+}
+
+#define FAST(n) [(n) - SYS_user_base] = 1
+
+//
+// the system calls that return to the calling process without a context switch. they save
+// and restore only the registers that C code does not preserve (see strap_vector.S). a
+// system call that may block, or that copies or replaces the trapframe (fork, exec), must
+// not be listed here.
+//
+unsigned char syscall_fast[SYS_user_nfast] = {
+  FAST(SYS_user_print),     FAST(SYS_user_allocate_page), FAST(SYS_user_free_page),
+  FAST(SYS_user_getline),   FAST(SYS_user_open),          FAST(SYS_user_read),
+  FAST(SYS_user_write),     FAST(SYS_user_close),         FAST(SYS_user_getinfo),
+  FAST(SYS_user_nice),      FAST(SYS_user_gettime),       FAST(SYS_user_getstat),
+  FAST(SYS_user_sched_deadline), FAST(SYS_user_group_create), FAST(SYS_user_group_join),
+  FAST(SYS_user_group_stat), FAST(SYS_user_getpid),   FAST(SYS_user_uring_setup),
+  FAST(SYS_user_uring_enter), FAST(SYS_user_syscall_stat), FAST(SYS_user_readv),
+  FAST(SYS_user_writev),    FAST(SYS_user_preadv),        FAST(SYS_user_pwritev),
+  FAST(SYS_user_dmesg),      FAST(SYS_user_spawn),
+};
+
+//
+// the boot argument "syscall=slow" turns the fast path off, e.g., to measure it.
+//
+void syscall_init() {
+  char mode[16];
+
+  if (bootarg_get("syscall", mode, sizeof(mode)) && strcmp(mode, "slow") == 0) {
+    memset(syscall_fast, 0, sizeof(syscall_fast));
+    sprint("fast system call path disabled.\n");
+  }
+}
+
 //
 // [a0]: the syscall number; [a1] ... [a7]: arguments to the syscalls.
 // returns the code of success, (e.g., 0 means success, fail for otherwise)
 //
-long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, long a6, long a7) {
+static long syscall_dispatch(long a0, long a1, long a2, long a3, long a4, long a5, long a6,
+                             long a7) {
   switch (a0) {
     case SYS_user_print:
       return sys_user_print((const char*)a1, a2);
@@ -204,7 +533,70 @@ long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, long a6, l
       return sys_user_close(a1);
     case SYS_user_getinfo:
       return sys_user_getinfo();
+    case SYS_user_nice:
+      return sys_user_nice(a1, a2);
+    case SYS_user_nanosleep:
+      return sys_user_nanosleep(a1);
+    case SYS_user_sleep_until:
+      return sys_user_sleep_until(a1);
+    case SYS_user_gettime:
+      return sys_user_gettime();
+    case SYS_user_wait_timeout:
+      return sys_user_wait_timeout(a1, a2);
+    case SYS_user_getstat:
+      return sys_user_getstat(a1, (struct proc_stat*)a2);
+    case SYS_user_sched_deadline:
+      return sys_user_sched_deadline(a1, a2, a3);
+    case SYS_user_group_create:
+      return sys_user_group_create(a1, a2);
+    case SYS_user_group_join:
+      return sys_user_group_join(a1);
+    case SYS_user_group_stat:
+      return sys_user_group_stat(a1, (struct group_stat*)a2);
+    case SYS_user_getpid:
+      return sys_user_getpid();
+    case SYS_user_uring_setup:
+      return sys_user_uring_setup();
+    case SYS_user_uring_enter:
+      return sys_user_uring_enter(a1);
+    case SYS_user_syscall_stat:
+      return sys_user_syscall_stat(a1, a2, (struct syscall_stat*)a3);
+    case SYS_user_readv:
+      return sys_user_readv(a1, (struct iovec*)a2, a3);
+    case SYS_user_writev:
+      return sys_user_writev(a1, (struct iovec*)a2, a3);
+    case SYS_user_preadv:
+      return sys_user_preadv(a1, (struct iovec*)a2, a3, a4);
+    case SYS_user_pwritev:
+      return sys_user_pwritev(a1, (struct iovec*)a2, a3, a4);
+    case SYS_user_dmesg:
+      return sys_user_dmesg((char *)a1, a2);
+    case SYS_user_spawn:
+      return sys_user_spawn((char *)a1, (char **)a2, (struct spawn_action *)a3);
+    case SYS_user_vfork:
+      return sys_user_vfork();
     default:
       panic("Unknown syscall %ld \n", a0);
   }
 }
+
+//
+// run a system call, and count it per process and globally when built with SYSCALL_STATS.
+//
+long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, long a6, long a7) {
+#ifdef SYSCALL_STATS
+  uint64 start = read_cycle();
+  long ret = syscall_dispatch(a0, a1, a2, a3, a4, a5, a6, a7);
+  uint64 cycles = read_cycle() - start;
+  long nr = a0 - SYS_user_base;
+
+  if (nr >= 0 && nr < SYSCALL_STAT_NR) {
+    int b = syscall_hist_bucket(cycles);
+    syscall_stat_add(&syscall_stats[nr], ret, cycles, b);
+    syscall_stat_add(&current->syscall_stats[nr], ret, cycles, b);
+  }
+  return ret;
+#else
+  return syscall_dispatch(a0, a1, a2, a3, a4, a5, a6, a7);
+#endif
+}
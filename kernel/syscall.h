@@ -24,7 +24,47 @@
 #define SYS_user_close (SYS_user_base + 20)
 
 #define SYS_user_getinfo (SYS_user_base + 21)
+#define SYS_user_nice (SYS_user_base + 22)
+// sleeps and timeouts
+#define SYS_user_nanosleep (SYS_user_base + 23)
+#define SYS_user_sleep_until (SYS_user_base + 24)
+#define SYS_user_gettime (SYS_user_base + 25)
+#define SYS_user_wait_timeout (SYS_user_base + 26)
+#define SYS_user_getstat (SYS_user_base + 27)
+#define SYS_user_sched_deadline (SYS_user_base + 28)
+// cpu bandwidth groups
+#define SYS_user_group_create (SYS_user_base + 29)
+#define SYS_user_group_join (SYS_user_base + 30)
+#define SYS_user_group_stat (SYS_user_base + 31)
+#define SYS_user_getpid (SYS_user_base + 32)
+// batched system calls
+#define SYS_user_uring_setup (SYS_user_base + 33)
+#define SYS_user_uring_enter (SYS_user_base + 34)
+// per-syscall counters (see syscall_stat.h)
+#define SYS_user_syscall_stat (SYS_user_base + 35)
+// scatter/gather and positional i/o (see uio.h)
+#define SYS_user_readv (SYS_user_base + 36)
+#define SYS_user_writev (SYS_user_base + 37)
+#define SYS_user_preadv (SYS_user_base + 38)
+#define SYS_user_pwritev (SYS_user_base + 39)
+// the kernel log (see klog.h)
+#define SYS_user_dmesg (SYS_user_base + 40)
+// fork and exec in one (see spawn.h)
+#define SYS_user_spawn (SYS_user_base + 41)
+// fork without copying the address space (see do_vfork)
+#define SYS_user_vfork (SYS_user_base + 42)
 
+// size of the table of fast system calls (see syscall_fast), all syscall numbers are below
+// SYS_user_base + SYS_user_nfast
+#define SYS_user_nfast 64
+
+#ifndef __ASSEMBLER__
+// syscall_fast[n - SYS_user_base] is set if system call n never switches to another
+// process, and takes the fast path of the trap vector (see strap_vector.S)
+extern unsigned char syscall_fast[SYS_user_nfast];
+
+void syscall_init();
 long do_syscall(long a0, long a1, long a2, long a3, long a4, long a5, long a6, long a7);
+#endif
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef _SYSCALL_STAT_H_
+#define _SYSCALL_STAT_H_
+
+#include "util/types.h"
+
+// system calls SYS_user_base .. SYS_user_base + SYSCALL_STAT_NR - 1 are counted. a table of
+// them has to fit in a page (see alloc_process).
+#define SYSCALL_STAT_NR 44
+
+// latency histogram: bucket i counts the calls that took [2^(i + SHIFT), 2^(i + SHIFT + 1))
+// cycles. the first bucket also holds the faster ones, the last the slower ones.
+#define SYSCALL_HIST_BUCKETS 16
+#define SYSCALL_HIST_SHIFT 6
+
+//
+// counters of one system call, as returned by the syscall_stat system call. kept when the
+// kernel is built with -DSYSCALL_STATS (make SYSCALL_STATS=1). a call that blocks is
+// restarted (see sleep_on), only the run that returns is counted.
+//
+struct syscall_stat {
+  uint64 calls;
+  uint64 errors;   // calls that returned a negative value
+  uint64 cycles;   // total latency, rdcycle
+  uint32 hist[SYSCALL_HIST_BUCKETS];
+};
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * kernel timers, kept in a hashed hierarchical timer wheel. adding and removing a timer
+ * take O(1); a timer is filed again ("cascaded") at most once per level on its way down to
+ * the first level, from where it expires.
+ */
+
+#include "timer.h"
+#include "smp.h"
+#include "memlayout.h"
+#include "spike_interface/spike_utils.h"
+
+// wheel[level][slot] heads a list of timers
+static ktimer *wheel[TVR_LEVELS][TVR_SIZE];
+// the next jiffy to be processed by timer_run
+static uint64 wheel_clk;
+// a lower bound of the earliest expiry (in jiffies, -1 if none), while next_valid is set
+static uint64 next_expiry;
+static int next_valid;
+
+uint64 g_boot_time;
+
+// both are exact for a timebase in whole kHz, and do not overflow for some 20 days.
+uint64 ns_to_time(uint64 ns) { return ns * (g_timebase / 1000) / 1000000; }
+
+uint64 time_to_ns(uint64 time) { return time * 1000000 / (g_timebase / 1000); }
+
+void timer_init() {
+  g_boot_time = read_time();
+  wheel_clk = time_to_jiffy(g_boot_time);
+}
+
+//
+// file t in the slot that matches its distance from wheel_clk. timers already due go to the
+// slot of wheel_clk, which expires next.
+//
+static void wheel_insert(ktimer *t) {
+  uint64 expires = t->expires;
+  int64 delta = (int64)(expires - wheel_clk);
+  int level = 0;
+
+  if (delta < 0) {
+    expires = wheel_clk;
+  } else {
+    while (level < TVR_LEVELS - 1 && (uint64)delta >= 1UL << (TVR_BITS * (level + 1)))
+      level++;
+    // beyond the range of the wheel: wait in the furthest slot of the last level.
+    if ((uint64)delta >= 1UL << (TVR_BITS * TVR_LEVELS))
+      expires = wheel_clk + (1UL << (TVR_BITS * TVR_LEVELS)) - 1;
+  }
+
+  ktimer **slot = &wheel[level][(expires >> (TVR_BITS * level)) & TVR_MASK];
+  t->next = *slot;
+  if (t->next) t->next->pprev = &t->next;
+  t->pprev = slot;
+  *slot = t;
+}
+
+//
+// arm t to expire at jiffy expires. an armed timer is moved.
+//
+void timer_add(ktimer *t, uint64 expires) {
+  timer_del(t);
+  t->expires = expires;
+  wheel_insert(t);
+  if (next_valid && expires < next_expiry) next_expiry = expires;
+}
+
+//
+// disarm t, if it is armed.
+//
+void timer_del(ktimer *t) {
+  if (!timer_pending(t)) return;
+  *t->pprev = t->next;
+  if (t->next) t->next->pprev = t->pprev;
+  t->next = 0;
+  t->pprev = 0;
+}
+
+//
+// refile the timers of a slot of a higher level, which now fall in a lower one.
+//
+static int cascade(int level) {
+  int idx = (wheel_clk >> (TVR_BITS * level)) & TVR_MASK;
+  ktimer *t = wheel[level][idx];
+
+  wheel[level][idx] = 0;
+  while (t) {
+    ktimer *next = t->next;
+    t->pprev = 0;
+    wheel_insert(t);
+    t = next;
+  }
+  return idx;
+}
+
+//
+// run the timers that expired up to jiffy now. called from the timer tick.
+//
+void timer_run(uint64 now) {
+  while ((int64)(now - wheel_clk) >= 0) {
+    int idx = wheel_clk & TVR_MASK;
+
+    // at every wrap of a level, bring the next slot of the level above down.
+    for (int level = 1, i = idx; !i && level < TVR_LEVELS; level++) i = cascade(level);
+
+    // take the expired list out of the wheel. it stays a proper list (headed by list), so
+    // that func may delete the timers that are still on it.
+    ktimer *list = wheel[0][idx], *t;
+    wheel[0][idx] = 0;
+    if (list) list->pprev = &list;
+    // a timer that func adds for the jiffy being processed goes to the next slot.
+    wheel_clk++;
+
+    while ((t = list)) {
+      list = t->next;
+      if (list) list->pprev = &list;
+      t->next = 0;
+      t->pprev = 0;
+      t->func(t);
+    }
+  }
+  next_valid = 0;
+}
+
+//
+// find the first non-empty slot of each level. the timers of a higher-level slot are only
+// known to expire after the start of the slot, which then serves as their expiry.
+//
+static uint64 wheel_scan() {
+  uint64 best = -1;
+
+  for (int i = 0; i < TVR_SIZE; i++)
+    if (wheel[0][(wheel_clk + i) & TVR_MASK]) {
+      best = wheel_clk + i;
+      break;
+    }
+
+  for (int level = 1; level < TVR_LEVELS; level++) {
+    uint64 base = wheel_clk >> (TVR_BITS * level);
+    // the slot of base itself holds timers a whole turn ahead, it comes last.
+    for (int i = 1; i <= TVR_SIZE; i++)
+      if (wheel[level][(base + i) & TVR_MASK]) {
+        uint64 start = (base + i) << (TVR_BITS * level);
+        if (start < best) best = start;
+        break;
+      }
+  }
+  return best;
+}
+
+//
+// the earliest time (in rdtime units) at which a kernel timer may expire, or -1 if there
+// are no timers. it may be early, but never late. the wheel is only scanned again after
+// timers ran.
+//
+uint64 timer_next_expiry() {
+  if (!next_valid) {
+    next_expiry = wheel_scan();
+    next_valid = 1;
+  }
+  return next_expiry == -1UL ? -1UL : next_expiry * TIMER_JIFFY;
+}
+
+//
+// set the timer interrupt of this hart to fire at when (rdtime), -1 turns it off (and
+// acknowledges a pending supervisor timer irq). with Sstc this is a csr write, otherwise the
+// CLINT is written, and M-mode passes the irq on (see kernel/machine/mtrap.c).
+//
+void timer_program(uint64 when) {
+  if (g_sstc)
+    write_stimecmp(when);
+  else
+    *(volatile uint64 *)KERN_CLINT_MTIMECMP(cpuid()) = when;
+}
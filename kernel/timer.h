@@ -0,0 +1,53 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "riscv.h"
+#include "config.h"
+
+// length of a timer jiffy, the resolution of kernel timers, in rdtime units
+#define TIMER_JIFFY (TIMER_INTERVAL / 10)
+
+// the wheel: TVR_LEVELS levels of TVR_SIZE slots, level i has a granularity of
+// TVR_SIZE^i jiffies. timers further out than TVR_SIZE^TVR_LEVELS jiffies wait in the last
+// slot and are filed again when it cascades.
+#define TVR_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVR_LEVELS 4
+
+//
+// a kernel timer. func(t) runs from the timer interrupt of whichever hart finds it expired
+// first (under the kernel lock), once the jiffy count reaches expires.
+//
+typedef struct ktimer {
+  uint64 expires;                 // in jiffies
+  void (*func)(struct ktimer *t);
+  void *data;                     // for use by func
+
+  // links in the wheel slot. pprev points to the previous next field (or the slot head),
+  // so that a timer is removed in O(1) without knowing its slot.
+  struct ktimer *next;
+  struct ktimer **pprev;
+} ktimer;
+
+// rdtime at the start of the kernel
+extern uint64 g_boot_time;
+
+// convert between nanoseconds and rdtime units (see g_timebase)
+uint64 ns_to_time(uint64 ns);
+uint64 time_to_ns(uint64 time);
+
+void timer_init();
+void timer_add(ktimer *t, uint64 expires);
+void timer_del(ktimer *t);
+void timer_run(uint64 now);
+uint64 timer_next_expiry();
+void timer_program(uint64 when);
+
+static inline int timer_pending(ktimer *t) { return t->pprev != 0; }
+
+// the jiffy that contains rdtime value time, and the first jiffy that starts at or after it
+#define time_to_jiffy(time) ((time) / TIMER_JIFFY)
+#define time_to_jiffy_up(time) (((time) + TIMER_JIFFY - 1) / TIMER_JIFFY)
+
+#endif
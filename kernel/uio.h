@@ -0,0 +1,17 @@
+#ifndef _UIO_H_
+#define _UIO_H_
+
+#include "util/types.h"
+
+// most entries in the vector of one readv/writev/preadv/pwritev
+#define IOV_MAX 16
+
+//
+// one buffer of a scatter/gather i/o vector
+//
+struct iovec {
+  uint64 iov_base;  // user address
+  uint64 iov_len;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * batched system calls: the process queues operations in a ring shared with the kernel,
+ * and submits any number of them with one uring_enter system call.
+ */
+
+#include "uring.h"
+#include "process.h"
+#include "syscall.h"
+#include "vmm.h"
+#include "pmm.h"
+#include "memlayout.h"
+#include "util/string.h"
+#include "spike_interface/spike_utils.h"
+
+//
+// map a ring page into the current process at URING_VA. returns the address, or 0 if the
+// process has its rings already.
+//
+uint64 do_uring_setup() {
+  process *proc = current;
+  if (proc->uring) return 0;
+
+  void *page = alloc_page();
+  memset(page, 0, PGSIZE);
+  user_vm_map(proc->pagetable, URING_VA, PGSIZE, (uint64)page,
+              prot_to_type(PROT_READ | PROT_WRITE, 1));
+
+  // the kernel writes the page through its physical address, so it must stay where it is:
+  // SHARED_SEGMENT keeps ksm away from it.
+  mapped_region *r = &proc->mapped_info[proc->total_mapped_region++];
+  r->va = URING_VA;
+  r->npages = 1;
+  r->seg_type = SHARED_SEGMENT;
+
+  proc->uring = (struct uring *)page;
+  return URING_VA;
+}
+
+//
+// run one queued operation through the system call it stands for.
+//
+static int64 uring_run(struct uring_sqe *sqe) {
+  switch (sqe->opcode) {
+    case URING_OP_NOP:
+      return 0;
+    case URING_OP_READ:
+      return do_syscall(SYS_user_read, sqe->fd, sqe->addr, sqe->len, 0, 0, 0, 0);
+    case URING_OP_WRITE:
+      return do_syscall(SYS_user_write, sqe->fd, sqe->addr, sqe->len, 0, 0, 0, 0);
+    case URING_OP_OPEN:
+      return do_syscall(SYS_user_open, sqe->addr, sqe->len, 0, 0, 0, 0, 0);
+    case URING_OP_CLOSE:
+      return do_syscall(SYS_user_close, sqe->fd, 0, 0, 0, 0, 0, 0);
+    case URING_OP_ALLOC:
+      return do_syscall(SYS_user_allocate_page, 0, 0, 0, 0, 0, 0, 0);
+    default:
+      return -1;
+  }
+}
+
+//
+// run up to to_submit queued operations, as long as the completion ring has room. returns
+// the number of operations run, or -1 if the process has no rings.
+//
+int do_uring_enter(int to_submit) {
+  struct uring *ring = current->uring;
+  int n = 0;
+
+  if (!ring) return -1;
+  while (n < to_submit && ring->sq_head != ring->sq_tail &&
+         ring->cq_tail - ring->cq_head < URING_ENTRIES) {
+    // a copy, the process may reuse the slot as soon as sq_head moves on.
+    struct uring_sqe sqe = ring->sq[ring->sq_head & (URING_ENTRIES - 1)];
+    ring->sq_head++;
+
+    struct uring_cqe *cqe = &ring->cq[ring->cq_tail & (URING_ENTRIES - 1)];
+    cqe->user_data = sqe.user_data;
+    cqe->res = uring_run(&sqe);
+    ring->cq_tail++;
+    n++;
+  }
+  return n;
+}
@@ -0,0 +1,45 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+#include "util/types.h"
+
+//
+// submission and completion rings of a process, in one page shared between the process and
+// the kernel (see uring_setup). the process queues operations at sq_tail and calls
+// uring_enter, which runs them in order and posts one completion each at cq_tail. the
+// counters run freely, a slot is counter & (URING_ENTRIES - 1).
+//
+#define URING_ENTRIES 64
+
+// operations
+#define URING_OP_NOP 0
+#define URING_OP_READ 1   // read(fd, addr, len)
+#define URING_OP_WRITE 2  // write(fd, addr, len)
+#define URING_OP_OPEN 3   // open(addr: path, len: flags)
+#define URING_OP_CLOSE 4  // close(fd)
+#define URING_OP_ALLOC 5  // allocate a page, the result is its address
+
+struct uring_sqe {
+  uint32 opcode;
+  int32 fd;
+  uint64 addr;
+  uint64 len;
+  uint64 user_data;  // passed on to the completion
+};
+
+struct uring_cqe {
+  uint64 user_data;
+  int64 res;  // the return value of the operation, -1 for an unknown opcode
+};
+
+struct uring {
+  uint32 sq_head;  // next submission the kernel takes
+  uint32 sq_tail;  // next free submission slot (written by the process)
+  uint32 cq_head;  // next completion the process takes (written by the process)
+  uint32 cq_tail;  // next free completion slot
+  uint32 pad[12];
+  struct uring_sqe sq[URING_ENTRIES];
+  struct uring_cqe cq[URING_ENTRIES];
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * the kernel data page: counters that a process reads from a page of its own, without a
+ * system call. the page is mapped read-only at VDSO_VA, and written by the kernel through
+ * its physical address.
+ */
+
+#include "vdso.h"
+#include "process.h"
+#include "sched.h"
+#include "smp.h"
+#include "vmm.h"
+#include "pmm.h"
+#include "string.h"
+#include "spike_interface/spike_utils.h"
+
+extern uint64 g_ticks;
+
+//
+// let user mode read time and cycle by itself (rdtime, rdcycle). called on every hart.
+//
+void vdso_hart_init() {
+  write_csr(scounteren, SCOUNTEREN_CY | SCOUNTEREN_TM);
+}
+
+//
+// allocate the data page of proc, and map it at VDSO_VA. recorded as mapped_info[3].
+//
+void vdso_map(process *proc) {
+  struct vdso_data *vd = (struct vdso_data *)alloc_page();
+
+  memset(vd, 0, PGSIZE);
+  vd->pid = proc->pid;
+  vd->timebase = g_timebase;
+  vd->boot_time = g_boot_time;
+  user_vm_map(proc->pagetable, VDSO_VA, PGSIZE, (uint64)vd, prot_to_type(PROT_READ, 1));
+
+  proc->mapped_info[3].va = VDSO_VA;
+  proc->mapped_info[3].npages = 1;
+  proc->mapped_info[3].seg_type = VDSO_SEGMENT;
+  proc->vdso = vd;
+}
+
+//
+// publish the counters to the data page of proc, before it returns to user mode. the pid
+// too: a vfork child runs on the page of its parent, which then shows the child's values.
+//
+void vdso_update(process *proc) {
+  struct vdso_data *vd = proc->vdso;
+  uint64 nr_cpus = 0;
+
+  for (int i = 0; i < NCPU; i++) nr_cpus += g_cpu_online[i];
+
+  vd->seq++;
+  asm volatile("fence w, w" ::: "memory");
+  vd->pid = proc->pid;
+  vd->ticks = g_ticks;
+  vd->time = read_time();
+  vd->nr_running = sched_nr_running();
+  vd->nr_cpus = nr_cpus;
+  proc_getstat(proc, &vd->stat);
+  asm volatile("fence w, w" ::: "memory");
+  vd->seq++;
+}
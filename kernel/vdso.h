@@ -0,0 +1,27 @@
+#ifndef _VDSO_H_
+#define _VDSO_H_
+
+#include "util/types.h"
+#include "proc_stat.h"
+
+// virtual address of the kernel data page, mapped read-only into every process
+#define VDSO_VA 0x70001000
+
+//
+// the kernel data page of a process. the kernel updates it every time the process returns
+// to user mode, under a sequence lock: seq is odd while an update is under way, and a
+// reader that saw it change retries (see vdso_read in user/user_lib.c).
+//
+struct vdso_data {
+  uint32 seq;
+  int pid;
+  uint64 ticks;       // g_ticks, scheduler ticks since boot
+  uint64 time;        // mtime at the update
+  uint64 timebase;    // frequency of mtime, in Hz
+  uint64 boot_time;   // mtime at boot (g_boot_time)
+  uint64 nr_running;  // processes running or ready to run, on all harts
+  uint64 nr_cpus;     // harts online
+  struct proc_stat stat;  // cpu accounting of the process, as returned by getstat
+};
+
+#endif
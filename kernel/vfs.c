@@ -1,5 +1,6 @@
 #include "vfs.h"
 #include "pmm.h"
+#include "klog.h"
 #include "util/string.h"
 #include "spike_interface/spike_utils.h"
 
@@ -117,7 +118,7 @@ int vfs_open(char *path, int flags, struct inode **inode_store){
   }
 
   ++ node->ref;
-  sprint("vfs_open: inode ref: %d\n", node->ref);
+  klog_debug("vfs_open: inode ref: %d\n", node->ref);
 
   *inode_store = node;
   return 0;
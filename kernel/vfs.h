@@ -96,12 +96,17 @@ struct inode {
 #define vop_create(node, name, node_store)    (node->in_ops->vop_create(node, name, node_store))
 #define vop_read(node, buf, len)              (node->in_ops->vop_read(node, buf, len))
 #define vop_write(node, buf, len)             (node->in_ops->vop_write(node, buf, len))
+#define vop_readv(node, iov, n, off)          (node->in_ops->vop_readv(node, iov, n, off))
+#define vop_writev(node, iov, n, off)         (node->in_ops->vop_writev(node, iov, n, off))
 
 struct inode_ops {
   int (*vop_open)(struct inode *node, int open_flags);
   int (*vop_close)(struct inode *node);
   int (*vop_read)(struct inode *node, char *buf, uint64 len);
   int (*vop_write)(struct inode *node, char *buf, uint64 len);
+  // scatter/gather i/o at offset off, returns the number of bytes moved or -1
+  int (*vop_readv)(struct inode *node, struct kiov *iov, int n, uint64 off);
+  int (*vop_writev)(struct inode *node, struct kiov *iov, int n, uint64 off);
   int (*vop_fstat)(struct inode *node, struct fstat *stat);
   // int (*vop_fsync)(struct inode *node);
   // int (*vop_namefile)(struct inode *node, struct iobuf *iob);
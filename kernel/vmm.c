@@ -10,6 +10,7 @@
 #include "util/string.h"
 #include "spike_interface/spike_utils.h"
 #include "util/functions.h"
+#include "smp.h"
 
 /* --- utility functions for virtual address mapping --- */
 //
@@ -27,19 +28,29 @@ int map_pages(pagetable_t page_dir, uint64 va, uint64 size, uint64 pa, int perm)
       panic("map_pages fails on mapping va (0x%lx) to pa (0x%lx)", first, pa);
     *pte = PA2PTE(pa) | perm | PTE_V;
   }
+  tlb_mark_stale();
   return 0;
 }
 
 //
 // convert permission code to permission types of PTE
 //
+// note: accessed/dirty bits are pre-set only for kernel mappings. user mappings start with
+// both bits clear, so that the first access (and the first write) to a user page traps and
+// is recorded by user_vm_access_fault(). the aging scan (user_vm_age) relies on this.
+//
 uint64 prot_to_type(int prot, int user) {
   uint64 perm = 0;
-  if (prot & PROT_READ) perm |= PTE_R | PTE_A;
-  if (prot & PROT_WRITE) perm |= PTE_W | PTE_D;
-  if (prot & PROT_EXEC) perm |= PTE_X | PTE_A;
+  if (prot & PROT_READ) perm |= PTE_R;
+  if (prot & PROT_WRITE) perm |= PTE_W;
+  if (prot & PROT_EXEC) perm |= PTE_X;
   if (perm == 0) perm = PTE_R;
-  if (user) perm |= PTE_U;
+  if (user)
+    perm |= PTE_U;
+  else {
+    if (perm & (PTE_R | PTE_X)) perm |= PTE_A;
+    if (perm & PTE_W) perm |= PTE_D;
+  }
   return perm;
 }
 
@@ -106,6 +117,8 @@ extern char _etext[];
 // pointer to kernel page director
 pagetable_t g_kernel_pagetable;
 
+int g_kmap_shared;
+
 //
 // maps virtual address [va, va+sz] to [pa, pa+sz] (for kernel).
 //
@@ -138,7 +151,17 @@ void kern_vm_init(void) {
 
   sprint("physical address of _etext is: 0x%lx\n", lookup_pa(t_page_dir, (uint64)_etext));
 
+  // map the CLINT, so that the kernel can send IPIs (see smp.c). not at its physical
+  // address, which user processes may map (see KERN_CLINT).
+  kern_vm_map(t_page_dir, KERN_CLINT, CLINT, CLINT_SIZE, prot_to_type(PROT_READ | PROT_WRITE, 0));
+
   g_kernel_pagetable = t_page_dir;
+
+  char mode[16];
+  if (bootarg_get("kmap", mode, sizeof(mode)) && strcmp(mode, "shared") == 0) {
+    g_kmap_shared = 1;
+    sprint("kernel mappings shared into user page tables.\n");
+  }
 }
 
 /* --- user page table part --- */
@@ -157,10 +180,10 @@ void *user_va_to_pa(pagetable_t page_dir, void *va) {
   // (va - va & (1<<PGSHIFT -1)) means computing the offset of "va" in its page.
   // Also, it is possible that "va" is not mapped at all. in such case, we can find
   // invalid PTE, and should return NULL.
-  uint64 page_addr = lookup_pa(page_dir, (uint64)va);
-
-  if (!page_addr)
-    return 0;
+  // only user mappings count: the kernel may be mapped as well (see user_vm_share_kernel).
+  pte_t *pte = (uint64)va < MAXVA ? page_walk(page_dir, (uint64)va, 0) : 0;
+  if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0) return 0;
+  uint64 page_addr = PTE2PA(*pte);
   return (void *)(page_addr + ((uint64)va & ((1 << PGSHIFT) - 1)));
 }
 
@@ -173,6 +196,17 @@ void user_vm_map(pagetable_t page_dir, uint64 va, uint64 size, uint64 pa, int pe
   }
 }
 
+//
+// install the kernel mappings (supervisor only) into a new user page table, so that the
+// kernel runs on it after a trap. the top-level entries of the direct map point to the
+// page tables of the kernel, which are thus shared by all processes. the mapping of the
+// CLINT follows the direct map (see KERN_CLINT), and is shared with it.
+//
+void user_vm_share_kernel(pagetable_t page_dir) {
+  for (int i = PX(2, KERN_BASE); i <= PX(2, KERN_CLINT + CLINT_SIZE - 1); i++)
+    page_dir[i] = g_kernel_pagetable[i];
+}
+
 //
 // unmap virtual address [va, va+size] from the user app.
 // reclaim the physical pages if free!=0
@@ -200,6 +234,152 @@ void user_vm_unmap(pagetable_t page_dir, uint64 va, uint64 size, int free) {
     }
     *pte = 0;
   }
+  tlb_mark_stale();
+}
+
+//
+// handle a page fault that is caused only by a clear accessed (or dirty) bit of a valid
+// user mapping. sets the missing bit(s) and returns 1, or returns 0 if the fault is a
+// real one (not mapped, or the access is not permitted by the PTE).
+//
+int user_vm_access_fault(pagetable_t page_dir, uint64 va, uint64 cause) {
+  pte_t *pte;
+
+  if (va >= MAXVA) return 0;
+  pte = page_walk(page_dir, va, 0);
+  if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0) return 0;
+
+  switch (cause) {
+    case CAUSE_STORE_PAGE_FAULT:
+      if ((*pte & PTE_W) == 0) return 0;
+      *pte |= PTE_A | PTE_D;
+      break;
+    case CAUSE_LOAD_PAGE_FAULT:
+      if ((*pte & PTE_R) == 0) return 0;
+      *pte |= PTE_A;
+      break;
+    case CAUSE_FETCH_PAGE_FAULT:
+      if ((*pte & PTE_X) == 0) return 0;
+      *pte |= PTE_A;
+      break;
+    default:
+      return 0;
+  }
+  tlb_mark_stale();
+  return 1;
+}
+
+//
+// handle a store fault on a copy-on-write (PTE_COW) page. the last sharer simply gets its
+// write permission back, any other sharer gets a private copy of the page.
+// returns 1 if the fault is handled, 0 if va is not a copy-on-write page.
+//
+int user_vm_cow_fault(pagetable_t page_dir, uint64 va) {
+  pte_t *pte;
+
+  if (va >= MAXVA) return 0;
+  pte = page_walk(page_dir, va, 0);
+  if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_COW) == 0) return 0;
+
+  uint64 pa = PTE2PA(*pte);
+  uint64 flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W | PTE_A | PTE_D;
+  if (page_ref_count((void *)pa) > 1) {
+    void *copy = alloc_page();
+    if (copy == 0) panic("user_vm_cow_fault: out of memory\n");
+    memcpy(copy, (void *)pa, PGSIZE);
+    free_page((void *)pa);  // drops our reference to the shared page
+    pa = (uint64)copy;
+  }
+  *pte = PA2PTE(pa) | flags;
+  tlb_mark_stale();
+  return 1;
+}
+
+//
+// like user_va_to_pa, for a store by the kernel to user address va: the page must be
+// writable by the user, and is unshared first if it was merged (see user_vm_cow_fault).
+// it is marked accessed and dirty, as a store from user mode would, so that the same-page
+// merging leaves it alone. the result is valid up to the end of the page of va.
+//
+void *user_va_to_pa_writable(pagetable_t page_dir, void *va) {
+  user_vm_cow_fault(page_dir, (uint64)va);
+
+  pte_t *pte = (uint64)va < MAXVA ? page_walk(page_dir, (uint64)va, 0) : 0;
+  if (pte == 0 || (*pte & (PTE_V | PTE_U | PTE_W)) != (PTE_V | PTE_U | PTE_W)) return 0;
+  *pte |= PTE_A | PTE_D;
+  return (void *)(PTE2PA(*pte) + ((uint64)va & (PGSIZE - 1)));
+}
+
+//
+// copy len bytes from the kernel address src to user address va, page by page (see
+// user_va_to_pa_writable). returns -1 if a page of the buffer cannot be written.
+//
+int copy_to_user(pagetable_t page_dir, uint64 va, const void *src, uint64 len) {
+  while (len > 0) {
+    uint64 n = ROUNDDOWN(va, PGSIZE) + PGSIZE - va;
+    if (n > len) n = len;
+    void *pa = user_va_to_pa_writable(page_dir, (void *)va);
+    if (!pa) return -1;
+    memcpy(pa, src, n);
+    src = (const char *)src + n;
+    va += n;
+    len -= n;
+  }
+  return 0;
+}
+
+//
+// call visit() for every valid user (PTE_U) leaf entry of a user page table.
+// mapped_info does not record heap pages and the pages added by stack growth, so the
+// walk goes through the page table itself.
+//
+void user_vm_walk(pagetable_t page_dir, void (*visit)(pte_t *pte, uint64 va, void *arg),
+                  void *arg) {
+  for (int i = 0; i < 512; i++) {
+    if ((page_dir[i] & PTE_V) == 0 || (page_dir[i] & (PTE_R | PTE_W | PTE_X))) continue;
+    // the shared kernel mappings hold no user pages.
+    if (g_kmap_shared && page_dir[i] == g_kernel_pagetable[i]) continue;
+    pagetable_t pmd = (pagetable_t)PTE2PA(page_dir[i]);
+    for (int j = 0; j < 512; j++) {
+      if ((pmd[j] & PTE_V) == 0 || (pmd[j] & (PTE_R | PTE_W | PTE_X))) continue;
+      pagetable_t pt = (pagetable_t)PTE2PA(pmd[j]);
+      for (int k = 0; k < 512; k++) {
+        if ((pt[k] & PTE_V) == 0 || (pt[k] & PTE_U) == 0) continue;
+        uint64 va = ((uint64)i << PXSHIFT(2)) | ((uint64)j << PXSHIFT(1)) |
+                    ((uint64)k << PXSHIFT(0));
+        visit(&pt[k], va, arg);
+      }
+    }
+  }
+}
+
+//
+// one aging step for a user page: sample and clear its accessed/dirty bits. a page that is
+// found unreferenced in two scans in a row is counted as idle (PTE_IDLE marks the first).
+//
+static void age_user_page(pte_t *pte, uint64 va, void *arg) {
+  wss_sample *s = (wss_sample *)arg;
+
+  s->mapped++;
+  if (*pte & PTE_A) {
+    s->referenced++;
+    if (*pte & PTE_D) s->dirtied++;
+    *pte &= ~(PTE_A | PTE_D | PTE_IDLE);
+  } else if (*pte & PTE_IDLE) {
+    s->idle++;
+  } else {
+    *pte |= PTE_IDLE;
+  }
+}
+
+//
+// sample (and clear) the accessed/dirty bits of all user pages in page_dir.
+// the tlb is flushed before the process runs again (see tlb_shootdown), so the cleared bits
+// trap again on the next access.
+//
+void user_vm_age(pagetable_t page_dir, wss_sample *s) {
+  memset(s, 0, sizeof(*s));
+  user_vm_walk(page_dir, age_user_page, s);
 }
 
 //
@@ -215,6 +395,8 @@ void print_proc_vmspace(process* proc) {
       case STACK_SEGMENT: sprint( "type: STACK SEGMENT" ); break;
       case CONTEXT_SEGMENT: sprint( "type: TRAPFRAME SEGMENT" ); break;
       case SYSTEM_SEGMENT: sprint( "type: USER KERNEL STACK SEGMENT" ); break;
+      case SHARED_SEGMENT: sprint( "type: SHARED SEGMENT" ); break;
+      case VDSO_SEGMENT: sprint( "type: VDSO SEGMENT" ); break;
     }
     sprint( ", mapped to pa:%lx\n", lookup_pa(proc->pagetable, proc->mapped_info[i].va) );
   }
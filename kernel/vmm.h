@@ -24,6 +24,10 @@ extern pagetable_t g_kernel_pagetable;
 
 void kern_vm_map(pagetable_t page_dir, uint64 va, uint64 pa, uint64 sz, int perm);
 
+// set (boot argument "kmap=shared") if the kernel mappings are shared into the user page
+// tables, so that a trap does not switch satp
+extern int g_kmap_shared;
+
 // Initialize the kernel pagetable
 void kern_vm_init(void);
 
@@ -31,7 +35,25 @@ void kern_vm_init(void);
 void *user_va_to_pa(pagetable_t page_dir, void *va);
 void user_vm_map(pagetable_t page_dir, uint64 va, uint64 size, uint64 pa, int perm);
 void user_vm_unmap(pagetable_t page_dir, uint64 va, uint64 size, int free);
+void user_vm_share_kernel(pagetable_t page_dir);
 void *user_va_to_pa(pagetable_t page_dir, void *va);
 void print_proc_vmspace(process* proc);
 
+/* --- accessed/dirty bit tracking --- */
+// result of one aging scan over the user pages of a page table
+typedef struct wss_sample {
+  int mapped;      // user pages mapped
+  int referenced;  // pages accessed since the previous scan
+  int dirtied;     // pages written since the previous scan
+  int idle;        // pages not accessed for two scans in a row
+} wss_sample;
+
+int user_vm_access_fault(pagetable_t page_dir, uint64 va, uint64 cause);
+int user_vm_cow_fault(pagetable_t page_dir, uint64 va);
+void *user_va_to_pa_writable(pagetable_t page_dir, void *va);
+int copy_to_user(pagetable_t page_dir, uint64 va, const void *src, uint64 len);
+void user_vm_walk(pagetable_t page_dir, void (*visit)(pte_t *pte, uint64 va, void *arg),
+                  void *arg);
+void user_vm_age(pagetable_t page_dir, wss_sample *s);
+
 #endif
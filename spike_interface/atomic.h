@@ -5,45 +5,112 @@
 #ifndef _RISCV_ATOMIC_H_
 #define _RISCV_ATOMIC_H_
 
-// Currently, interrupts are always disabled in M-mode.
-// todo: for PKE, wo turn on irq in lab_1_3_timer, so wo have to implement these two functions.
-#define disable_irqsave() (0)
-#define enable_irqrestore(flags) ((void)(flags))
+//
+// interrupts of the supervisor mode are turned off (sstatus.SIE) while an irqsave lock is
+// held, so that a trap handler cannot spin on a lock held by the code it interrupted.
+// flags is the previous value of the SIE bit.
+//
+#define IRQ_SIE_BIT 2  // SSTATUS_SIE
+
+static inline long disable_irqsave() {
+  long flags;
+  asm volatile("csrrci %0, sstatus, %1" : "=r"(flags) : "i"(IRQ_SIE_BIT) : "memory");
+  return flags & IRQ_SIE_BIT;
+}
+
+static inline void enable_irqrestore(long flags) {
+  if (flags) asm volatile("csrsi sstatus, %0" : : "i"(IRQ_SIE_BIT) : "memory");
+}
+
+#define mb() asm volatile("fence" ::: "memory")
+#define atomic_set(ptr, val) (*(volatile typeof(*(ptr))*)(ptr) = val)
+#define atomic_read(ptr) (*(volatile typeof(*(ptr))*)(ptr))
+
+//
+// read-modify-write operations with the A extension, on 32-bit or 64-bit objects (int,
+// long, pointers). all of them return the previous value, and are full barriers (.aqrl).
+//
+#define atomic_amo(op, ptr, val)                                                      \
+  ({                                                                                  \
+    typeof(*(ptr) + 0) res;                                                           \
+    if (sizeof(*(ptr)) == 8)                                                          \
+      asm volatile("amo" op ".d.aqrl %0, %2, %1"                                      \
+                   : "=r"(res), "+A"(*(ptr)) : "r"((long)(val)) : "memory");          \
+    else                                                                              \
+      asm volatile("amo" op ".w.aqrl %0, %2, %1"                                      \
+                   : "=r"(res), "+A"(*(ptr)) : "r"((long)(val)) : "memory");          \
+    res;                                                                              \
+  })
+#define atomic_add(ptr, inc) atomic_amo("add", ptr, inc)
+#define atomic_or(ptr, inc) atomic_amo("or", ptr, inc)
+#define atomic_and(ptr, inc) atomic_amo("and", ptr, inc)
+#define atomic_swap(ptr, inc) atomic_amo("swap", ptr, inc)
+
+//
+// compare-and-swap with a LR/SC loop. lr.w sign-extends, so 32-bit operands are compared
+// sign-extended as well.
+//
+#define atomic_cas(ptr, cmp, swp)                                                     \
+  ({                                                                                  \
+    typeof(*(ptr) + 0) res;                                                           \
+    long fail;                                                                        \
+    if (sizeof(*(ptr)) == 8)                                                          \
+      asm volatile("0: lr.d.aqrl %0, %2\n"                                            \
+                   "   bne %0, %3, 1f\n"                                              \
+                   "   sc.d.aqrl %1, %4, %2\n"                                        \
+                   "   bnez %1, 0b\n"                                                 \
+                   "1:"                                                               \
+                   : "=&r"(res), "=&r"(fail), "+A"(*(ptr))                            \
+                   : "r"((long)(cmp)), "r"((long)(swp)) : "memory");                  \
+    else                                                                              \
+      asm volatile("0: lr.w.aqrl %0, %2\n"                                            \
+                   "   bne %0, %3, 1f\n"                                              \
+                   "   sc.w.aqrl %1, %4, %2\n"                                        \
+                   "   bnez %1, 0b\n"                                                 \
+                   "1:"                                                               \
+                   : "=&r"(res), "=&r"(fail), "+A"(*(ptr))                            \
+                   : "r"((long)(int)(long)(cmp)), "r"((long)(swp)) : "memory");       \
+    res;                                                                              \
+  })
+
+//
+// contention counters of a lock, kept when the kernel is built with -DLOCK_STAT (make
+// LOCK_STAT=1). they are updated by the new holder, under the lock.
+//
+typedef struct {
+  unsigned long acquired;   // times the lock was taken
+  unsigned long contended;  // times the taker had to wait
+  unsigned long spins;      // total iterations spent waiting
+} lock_stat_t;
+
+#ifdef LOCK_STAT
+#define lock_stat_acquired(lock, nspins) \
+  do {                                   \
+    (lock)->stat.acquired++;             \
+    if (nspins) {                        \
+      (lock)->stat.contended++;          \
+      (lock)->stat.spins += (nspins);    \
+    }                                    \
+  } while (0)
+#else
+#define lock_stat_acquired(lock, nspins) ((void)(nspins))
+#endif
+
+/* --- test-and-test-and-set spinlock --- */
 
 typedef struct {
   int lock;
   // For debugging:
   char* name;       // Name of lock.
   struct cpu* cpu;  // The cpu holding the lock.
+#ifdef LOCK_STAT
+  lock_stat_t stat;
+#endif
 } spinlock_t;
 
 #define SPINLOCK_INIT \
   { 0 }
 
-#define mb() asm volatile("fence" ::: "memory")
-#define atomic_set(ptr, val) (*(volatile typeof(*(ptr))*)(ptr) = val)
-#define atomic_read(ptr) (*(volatile typeof(*(ptr))*)(ptr))
-
-#define atomic_binop(ptr, inc, op)         \
-  ({                                       \
-    long flags = disable_irqsave();        \
-    typeof(*(ptr)) res = atomic_read(ptr); \
-    atomic_set(ptr, op);                   \
-    enable_irqrestore(flags);              \
-    res;                                   \
-  })
-#define atomic_add(ptr, inc) atomic_binop(ptr, inc, res + (inc))
-#define atomic_or(ptr, inc) atomic_binop(ptr, inc, res | (inc))
-#define atomic_swap(ptr, inc) atomic_binop(ptr, inc, (inc))
-#define atomic_cas(ptr, cmp, swp)                           \
-  ({                                                        \
-    long flags = disable_irqsave();                         \
-    typeof(*(ptr)) res = *(volatile typeof(*(ptr))*)(ptr);  \
-    if (res == (cmp)) *(volatile typeof(ptr))(ptr) = (swp); \
-    enable_irqrestore(flags);                               \
-    res;                                                    \
-  })
-
 static inline int spinlock_trylock(spinlock_t* lock) {
   int res = atomic_swap(&lock->lock, -1);
   mb();
@@ -51,10 +118,11 @@ static inline int spinlock_trylock(spinlock_t* lock) {
 }
 
 static inline void spinlock_lock(spinlock_t* lock) {
+  long spins = 0;
   do {
-    while (atomic_read(&lock->lock))
-      ;
+    while (atomic_read(&lock->lock)) spins++;
   } while (spinlock_trylock(lock));
+  lock_stat_acquired(lock, spins);
 }
 
 static inline void spinlock_unlock(spinlock_t* lock) {
@@ -73,4 +141,99 @@ static inline void spinlock_unlock_irqrestore(spinlock_t* lock, long flags) {
   enable_irqrestore(flags);
 }
 
+/* --- ticket lock: waiters are served in arrival order --- */
+
+typedef struct {
+  // unsigned: the tickets wrap around.
+  /* offset:0 */ unsigned int next;   // next ticket to hand out
+  /* offset:4 */ unsigned int owner;  // ticket being served
+#ifdef LOCK_STAT
+  lock_stat_t stat;
+#endif
+} ticketlock_t;
+
+#define TICKETLOCK_INIT \
+  { 0, 0 }
+
+static inline void ticket_lock(ticketlock_t* lock) {
+  unsigned int ticket = atomic_add(&lock->next, 1);
+  long spins = 0;
+  while (atomic_read(&lock->owner) != ticket) spins++;
+  mb();
+  lock_stat_acquired(lock, spins);
+}
+
+// only the holder writes owner, so a plain store releases the lock.
+static inline void ticket_unlock(ticketlock_t* lock) {
+  mb();
+  atomic_set(&lock->owner, lock->owner + 1);
+}
+
+static inline long ticket_lock_irqsave(ticketlock_t* lock) {
+  long flags = disable_irqsave();
+  ticket_lock(lock);
+  return flags;
+}
+
+static inline void ticket_unlock_irqrestore(ticketlock_t* lock, long flags) {
+  ticket_unlock(lock);
+  enable_irqrestore(flags);
+}
+
+/* --- MCS queue lock: every waiter spins on its own node --- */
+
+typedef struct mcs_node {
+  struct mcs_node* next;  // the waiter queued behind us
+  int locked;             // set until our predecessor hands the lock over
+} mcs_node_t;
+
+typedef struct {
+  mcs_node_t* tail;  // last waiter, NULL if the lock is free
+#ifdef LOCK_STAT
+  lock_stat_t stat;
+#endif
+} mcslock_t;
+
+#define MCSLOCK_INIT \
+  { 0 }
+
+//
+// node belongs to the caller (usually on its stack) until the matching mcs_unlock().
+//
+static inline void mcs_lock(mcslock_t* lock, mcs_node_t* node) {
+  long spins = 0;
+  node->next = 0;
+  node->locked = 1;
+
+  mcs_node_t* prev = atomic_swap(&lock->tail, node);
+  if (prev) {
+    atomic_set(&prev->next, node);
+    while (atomic_read(&node->locked)) spins++;
+  }
+  mb();
+  lock_stat_acquired(lock, spins);
+}
+
+static inline void mcs_unlock(mcslock_t* lock, mcs_node_t* node) {
+  mb();
+  if (!atomic_read(&node->next)) {
+    // no known successor: free the lock, unless a waiter is just queueing up.
+    if (atomic_cas(&lock->tail, node, 0) == node) return;
+    while (!atomic_read(&node->next))
+      ;
+  }
+  atomic_set(&node->next->locked, 0);
+}
+
+static inline long mcs_lock_irqsave(mcslock_t* lock, mcs_node_t* node) {
+  long flags = disable_irqsave();
+  mcs_lock(lock, node);
+  return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcslock_t* lock, mcs_node_t* node, long flags) {
+  mcs_unlock(lock, node);
+  enable_irqrestore(flags);
+}
+
 #endif
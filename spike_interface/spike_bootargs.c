@@ -0,0 +1,55 @@
+/*
+ * scanning the kernel command line (the "bootargs" property of the /chosen node) from the
+ * DTS (Device Tree String). spike fills it with the value of its --bootargs option, e.g.,
+ * $ spike --bootargs="sched=mlfq" obj/riscv-pke obj/app_file
+ * output: the command line (stored in "char g_bootargs[]").
+ */
+#include "dts_parse.h"
+#include "spike_bootargs.h"
+#include "spike_interface/spike_utils.h"
+#include "string.h"
+
+char g_bootargs[BOOTARGS_MAXLEN];
+
+static void bootargs_prop(const struct fdt_scan_prop *prop, void *extra) {
+  if (!prop->node || strcmp(prop->node->name, "chosen")) return;
+  if (strcmp(prop->name, "bootargs")) return;
+
+  int len = prop->len < BOOTARGS_MAXLEN ? prop->len : BOOTARGS_MAXLEN;
+  memcpy(g_bootargs, prop->value, len);
+  g_bootargs[BOOTARGS_MAXLEN - 1] = '\0';
+}
+
+// scanning the kernel command line
+void query_bootargs(uint64 fdt) {
+  struct fdt_cb cb;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.prop = bootargs_prop;
+
+  g_bootargs[0] = '\0';
+  fdt_scan(fdt, &cb);
+}
+
+//
+// look up "key=value" in the command line. copies value (at most size-1 chars) to val and
+// returns 1 if key is present, returns 0 otherwise.
+//
+int bootarg_get(const char *key, char *val, int size) {
+  int klen = strlen(key);
+
+  for (const char *p = g_bootargs; *p;) {
+    while (*p == ' ') p++;
+    const char *end = p;
+    while (*end && *end != ' ') end++;
+
+    if (end - p > klen && p[klen] == '=' && !memcmp(p, key, klen)) {
+      int n = 0;
+      for (p += klen + 1; p < end && n < size - 1; p++) val[n++] = *p;
+      val[n] = '\0';
+      return 1;
+    }
+    p = end;
+  }
+  return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef _SPIKE_BOOTARGS_H_
+#define _SPIKE_BOOTARGS_H_
+
+#include "util/types.h"
+
+#define BOOTARGS_MAXLEN 256
+
+void query_bootargs(uint64 fdt);
+int bootarg_get(const char* key, char* val, int size);
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * scanning the /cpus node from the DTS (Device Tree String).
+ * output: the frequency of the real-time counter, i.e., the "timebase-frequency" property
+ * (stored in "uint64 g_timebase"), and the ISA string of the harts (stored in "g_isa").
+ */
+#include "dts_parse.h"
+#include "spike_cpu.h"
+#include "spike_interface/spike_utils.h"
+#include "string.h"
+
+uint64 g_timebase;
+char g_isa[ISA_MAXLEN];
+int g_sstc;
+
+static void cpus_prop(const struct fdt_scan_prop *prop, void *extra) {
+  if (!prop->node) return;
+
+  // the first cpu node (cpu@0) gives the ISA string, all harts are alike on spike.
+  if (!strcmp(prop->name, "riscv,isa") && !g_isa[0]) {
+    int len = prop->len < ISA_MAXLEN ? prop->len : ISA_MAXLEN;
+    memcpy(g_isa, prop->value, len);
+    g_isa[ISA_MAXLEN - 1] = '\0';
+    return;
+  }
+
+  if (strcmp(prop->node->name, "cpus")) return;
+  if (strcmp(prop->name, "timebase-frequency") || prop->len != 4) return;
+
+  // device tree cells are big-endian
+  uint32 v = prop->value[0];
+  g_timebase = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+// scanning the cpus node
+void query_cpus(uint64 fdt) {
+  struct fdt_cb cb;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.prop = cpus_prop;
+
+  g_timebase = 0;
+  g_isa[0] = '\0';
+  fdt_scan(fdt, &cb);
+  if (!g_timebase) g_timebase = DEFAULT_TIMEBASE;
+  g_sstc = isa_has_ext("sstc");
+}
+
+//
+// tell whether the ISA string lists the single-letter extension c (e.g., 'v'), which come
+// right after "rv64".
+//
+int isa_has_letter(char c) {
+  for (const char *p = g_isa + 4; *p && *p != '_'; p++)
+    if (*p == c) return 1;
+  return 0;
+}
+
+//
+// tell whether the ISA string lists the multi-letter extension ext (e.g., "sstc"). such
+// extensions follow the single-letter ones, each one after an underscore.
+//
+int isa_has_ext(const char *ext) {
+  int len = strlen(ext);
+
+  for (const char *p = g_isa; (p = strchr(p, '_')) != 0;) {
+    p++;
+    if (!memcmp(p, ext, len) && (p[len] == '_' || p[len] == '\0')) return 1;
+  }
+  return 0;
+}
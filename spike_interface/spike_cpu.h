@@ -0,0 +1,21 @@
+#ifndef _SPIKE_CPU_H_
+#define _SPIKE_CPU_H_
+
+#include "util/types.h"
+
+// frequency (Hz) of the rdtime counter (mtime) used when the DTB does not give one
+#define DEFAULT_TIMEBASE 10000000
+
+#define ISA_MAXLEN 256
+
+extern uint64 g_timebase;
+// the ISA string of the first hart ("riscv,isa" property), e.g. "rv64imafdc_zicntr_sstc"
+extern char g_isa[ISA_MAXLEN];
+// set if the harts implement the Sstc extension (supervisor-mode stimecmp)
+extern int g_sstc;
+
+void query_cpus(uint64 fdt);
+int isa_has_letter(char c);
+int isa_has_ext(const char *ext);
+
+#endif
@@ -121,6 +121,10 @@ ssize_t spike_file_pread(spike_file_t* f, void* buf, size_t size, off_t offset)
   return frontend_syscall(HTIFSYS_pread, f->kfd, (uint64)buf, size, offset, 0, 0, 0);
 }
 
+ssize_t spike_file_pwrite(spike_file_t* f, const void* buf, size_t size, off_t offset) {
+  return frontend_syscall(HTIFSYS_pwrite, f->kfd, (uint64)buf, size, offset, 0, 0, 0);
+}
+
 ssize_t spike_file_read(spike_file_t* f, void* buf, size_t size) {
   return frontend_syscall(HTIFSYS_read, f->kfd, (uint64)buf, size, 0, 0, 0, 0);
 }
@@ -60,6 +60,7 @@ ssize_t spike_file_lseek(spike_file_t* f, size_t ptr, int dir);
 ssize_t spike_file_read(spike_file_t* f, void* buf, size_t size);
 ssize_t spike_file_pread(spike_file_t* f, void* buf, size_t n, off_t off);
 ssize_t spike_file_write(spike_file_t* f, const void* buf, size_t n);
+ssize_t spike_file_pwrite(spike_file_t* f, const void* buf, size_t n, off_t off);
 void spike_file_decref(spike_file_t* f);
 void spike_file_init(void);
 int spike_file_dup(spike_file_t* f);
@@ -8,16 +8,21 @@
 #include "spike_htif.h"
 #include "util/functions.h"
 #include "util/snprintf.h"
+#include "util/string.h"
 #include "spike_utils.h"
 #include "spike_file.h"
+#include "kernel/config.h"
+#include "kernel/riscv.h"
 
 //=============    encapsulating htif syscalls, invoking Spike functions    =============
 long frontend_syscall(long n, uint64 a0, uint64 a1, uint64 a2, uint64 a3, uint64 a4,
       uint64 a5, uint64 a6) {
   static volatile uint64 magic_mem[8];
 
-  static spinlock_t lock = SPINLOCK_INIT;
-  spinlock_lock(&lock);
+  // the magic memory is held for a whole host round trip, queue the harts up on it.
+  static mcslock_t lock = MCSLOCK_INIT;
+  mcs_node_t node;
+  mcs_lock(&lock, &node);
 
   magic_mem[0] = n;
   magic_mem[1] = a0;
@@ -32,7 +37,7 @@ long frontend_syscall(long n, uint64 a0, uint64 a1, uint64 a2, uint64 a3, uint64
 
   long ret = magic_mem[0];
 
-  spinlock_unlock(&lock);
+  mcs_unlock(&lock, &node);
   return ret;
 }
 
@@ -42,19 +47,74 @@ void sgetline(char * dst, int size){
   dst[n-1] = '\0';
 }
 
-//===============    Spike-assisted printf, output string to terminal    ===============
-static uintptr_t mcall_console_putchar(uint8 ch) {
-  if (htif) {
-    htif_console_putchar(ch);
+//===============    buffered console output    ===============
+//
+// the console output of a hart is collected in a buffer of its own, and goes to the host
+// with one write (instead of a host round trip per character or per call): when a line is
+// complete, when the buffer is full, at the timer interrupt of the hart and before the
+// machine stops. a hart finds its buffer by the hartid in tp (set at the top of m_start,
+// and in the machine trap vector).
+//
+#define CONSOLE_BUF 512
+
+static struct console_buf {
+  char buf[CONSOLE_BUF];
+  int len;
+} console_bufs[NCPU];
+
+static void console_flush_buf(struct console_buf *cb) {
+  //you need spike_file_init before this call
+  if (cb->len) spike_file_write(stderr, cb->buf, cb->len);
+  cb->len = 0;
+}
+
+//
+// write the console output buffered on this hart.
+//
+void console_flush() {
+  uint64 id = read_tp();
+  if (id < NCPU) console_flush_buf(&console_bufs[id]);
+}
+
+//
+// write out the buffers of all harts, when the machine stops.
+//
+static void console_flush_all() {
+  for (int i = 0; i < NCPU; i++) console_flush_buf(&console_bufs[i]);
+}
+
+//
+// queue n bytes of s for the console. text that does not fit in the buffer goes straight
+// to the host.
+//
+void console_write(const char* s, int n) {
+  uint64 id = read_tp();
+  // the machine trap vector sets tp as well, so this holds for M-mode output too.
+  if (id >= NCPU) {
+    spike_file_write(stderr, s, n);
+    return;
+  }
+
+  struct console_buf *cb = &console_bufs[id];
+  if (cb->len + n > CONSOLE_BUF) console_flush_buf(cb);
+  if (n >= CONSOLE_BUF) {
+    spike_file_write(stderr, s, n);
+    return;
   }
-  return 0;
+  memcpy(cb->buf + cb->len, s, n);
+  cb->len += n;
+  for (int i = 0; i < n; i++)
+    if (s[i] == '\n') {
+      console_flush_buf(cb);
+      break;
+    }
 }
 
+//===============    Spike-assisted printf, output string to terminal    ===============
 void vprintk(const char* s, va_list vl) {
   char out[256];
   int res = vsnprintf(out, sizeof(out), s, vl);
-  //you need spike_file_init before this call
-  spike_file_write(stderr, out, res < sizeof(out) ? res : sizeof(out));
+  console_write(out, res < sizeof(out) ? res : sizeof(out));
 }
 
 void printk(const char* s, ...) {
@@ -67,7 +127,7 @@ void printk(const char* s, ...) {
 }
 
 void putstring(const char* s) {
-  while (*s) mcall_console_putchar(*s++);
+  console_write(s, strlen(s));
 }
 
 void vprintm(const char* s, va_list vl) {
@@ -89,6 +149,7 @@ void sprint(const char* s, ...) {
 void poweroff(uint16_t code) {
   assert(htif);
   sprint("Power off\r\n");
+  console_flush_all();
   if (htif) {
     htif_poweroff();
   } else {
@@ -102,6 +163,7 @@ void poweroff(uint16_t code) {
 
 void shutdown(int code) {
   sprint("System is shutting down with exit code %d.\n", code);
+  console_flush_all();
   frontend_syscall(HTIFSYS_exit, code, 0, 0, 0, 0, 0, 0);
   while (1)
     ;
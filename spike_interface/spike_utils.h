@@ -5,6 +5,8 @@
 #include "spike_file.h"
 #include "spike_memory.h"
 #include "spike_htif.h"
+#include "spike_bootargs.h"
+#include "spike_cpu.h"
 
 long frontend_syscall(long n, uint64 a0, uint64 a1, uint64 a2, uint64 a3, uint64 a4, uint64 a5,
                       uint64 a6);
@@ -12,6 +14,8 @@ long frontend_syscall(long n, uint64 a0, uint64 a1, uint64 a2, uint64 a3, uint64
 void poweroff(uint16 code) __attribute((noreturn));
 void sprint(const char* s, ...);
 void putstring(const char* s);
+void console_write(const char* s, int n);
+void console_flush();
 void shutdown(int) __attribute__((noreturn));
 void sgetline(char * dst, int size);
 
@@ -0,0 +1,36 @@
+/*
+ * prints the kernel log kept in memory, with the debug messages the console leaves out
+ * (the console shows up to info unless the kernel runs with console_loglevel=debug):
+ *   make run-app_dmesg
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+int main(int argc, char *argv[]) {
+  static char buf[4096];
+
+  // make a few records first: the fork and the wait go through the logged paths.
+  int pid = fork();
+  if (pid == 0) exit(0);
+  wait(pid);
+
+  int n = dmesg(buf, sizeof(buf) - 1);
+  if (n < 0) {
+    printu("dmesg failed.\n");
+    exit(-1);
+  }
+  buf[n] = '\0';
+
+  // printu takes up to 256 bytes: a line at a time.
+  for (char *line = buf; *line;) {
+    char *end = line;
+    while (*end && *end != '\n') end++;
+    if (*end) *end++ = '\0';
+    printu("%s\n", line);
+    line = end;
+  }
+
+  exit(0);
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*
+ * two processes sum series in floating point, and give up the processor after every step.
+ * each result is compared with the same sum taken in one go: they differ if the registers
+ * of one process leak into the other across the (lazy) floating point switch.
+ *   make run-app_fpu
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+#define TERMS 200
+
+//
+// sum of 1 / k^power for k = 1 .. TERMS, yielding after each term if slow is set.
+//
+static double series(int power, int slow) {
+  double sum = 0;
+
+  for (int k = 1; k <= TERMS; k++) {
+    double term = 1;
+    for (int i = 0; i < power; i++) term /= k;
+    sum += term;
+    if (slow) yield();
+  }
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  int child = fork();
+  // the parent sums 1/k^2 (pi^2/6), the child 1/k^4 (pi^4/90).
+  int power = child ? 2 : 4;
+  double slow = series(power, 1), fast = series(power, 0);
+
+  printu("%s: sum of 1/k^%d = %ld / 1000000, %s\n", child ? "parent" : "child", power,
+         (uint64)(slow * 1000000), slow == fast ? "ok" : "MISMATCH");
+
+  if (child) wait(child);
+  exit(0);
+  return 0;
+}
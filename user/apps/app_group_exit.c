@@ -0,0 +1,43 @@
+/*
+ * processes that run and exit in a cpu group with a quota: the exit path leaves the group
+ * while the scheduler still charges the last run of the process.
+ *   make run-app_group_exit
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+#define NCHILD 4
+
+int main(int argc, char *argv[]) {
+  struct group_stat st;
+  int pids[NCHILD];
+
+  // half of a hart, in periods of 10ms.
+  int id = group_create(5000000, 10000000);
+  if (id < 0 || group_join(id) < 0) {
+    printu("cannot make the group.\n");
+    exit(-1);
+  }
+
+  // the children spin long enough to be throttled, and exit in the group.
+  for (int i = 0; i < NCHILD; i++) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      uint64 end = gettime() + 20000000;
+      while (gettime() < end)
+        ;
+      exit(0);
+    }
+  }
+  for (int i = 0; i < NCHILD; i++) wait(pids[i]);
+
+  if (group_stat(id, &st) < 0) {
+    printu("group_stat failed.\n");
+    exit(-1);
+  }
+  printu("group %d: usage %ld us, throttled %ld times, %ld processes left\n", id,
+         st.usage / 1000, st.nr_throttled, st.nr_procs);
+  exit(0);
+  return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * writes records of a header and a payload with one pwritev each, to a file on the RAM
+ * disk, and reads them back into separate buffers with preadv.
+ *   make run-app_iovec
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+#include "util/string.h"
+
+#define NRECORDS 4
+
+struct header {
+  uint32 seq;
+  uint32 len;
+};
+
+int main(int argc, char *argv[]) {
+  static char payload[64], back[64];
+  struct header hdr, hdr_back;
+  struct iovec iov[2];
+  int fd = open("ramdisk0:/records", O_RDWR | O_CREATE), ok = 1;
+  uint64 rec_size = sizeof(hdr) + sizeof(payload);
+
+  for (int i = 0; i < NRECORDS; i++) {
+    hdr.seq = i;
+    hdr.len = sizeof(payload);
+    for (int j = 0; j < sizeof(payload); j++) payload[j] = 'a' + (i + j) % 26;
+
+    iov[0].iov_base = (uint64)&hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (uint64)payload;
+    iov[1].iov_len = sizeof(payload);
+    if (pwritev(fd, iov, 2, i * rec_size) != rec_size) ok = 0;
+  }
+
+  // backwards, so that every read seeks.
+  for (int i = NRECORDS - 1; i >= 0; i--) {
+    iov[0].iov_base = (uint64)&hdr_back;
+    iov[1].iov_base = (uint64)back;
+    if (preadv(fd, iov, 2, i * rec_size) != rec_size) ok = 0;
+    for (int j = 0; j < sizeof(back); j++)
+      if (back[j] != 'a' + (i + j) % 26) ok = 0;
+    printu("record %d: seq %d, len %d, payload %c%c%c...\n", i, hdr_back.seq, hdr_back.len,
+           back[0], back[1], back[2]);
+    if (hdr_back.seq != i) ok = 0;
+  }
+
+  printu(ok ? "records ok.\n" : "records MISMATCH.\n");
+  close(fd);
+  exit(0);
+  return 0;
+}
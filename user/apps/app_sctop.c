@@ -0,0 +1,76 @@
+/*
+ * prints the system calls that took the most time, with their call and error counts and
+ * latency percentiles (from the log2 histograms). needs a kernel built with the counters:
+ *   make clean && make run-app_sctop SYSCALL_STATS=1
+ * counts all processes since boot, or process pid if given: app_sctop pid
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+#define TOP 10
+
+static const char *names[SYSCALL_STAT_NR] = {
+  [0] = "print",      [1] = "exit",          [2] = "alloc_page",  [3] = "free_page",
+  [4] = "fork",       [5] = "yield",         [14] = "wait",       [15] = "getline",
+  [16] = "exec",      [17] = "open",         [18] = "read",       [19] = "write",
+  [20] = "close",     [21] = "getinfo",      [22] = "nice",       [23] = "nanosleep",
+  [24] = "sleep_until", [25] = "gettime",    [26] = "wait_timeout", [27] = "getstat",
+  [28] = "sched_deadline", [29] = "group_create", [30] = "group_join", [31] = "group_stat",
+  [32] = "getpid",    [33] = "uring_setup",  [34] = "uring_enter", [35] = "syscall_stat",
+  [36] = "readv",     [37] = "writev",       [38] = "preadv",     [39] = "pwritev",
+  [40] = "dmesg",     [41] = "spawn",        [42] = "vfork",
+};
+
+//
+// upper bound (in cycles) of the histogram bucket that holds the p-th percentile of st.
+//
+static uint64 percentile(struct syscall_stat *st, int p) {
+  uint64 seen = 0, rank = (st->calls * p + 99) / 100;
+
+  for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+    seen += st->hist[b];
+    if (seen >= rank) return 1UL << (b + SYSCALL_HIST_SHIFT + 1);
+  }
+  return -1UL;
+}
+
+int main(int argc, char *argv[]) {
+  static struct syscall_stat stats[SYSCALL_STAT_NR];
+  int order[SYSCALL_STAT_NR], n = 0, pid = -1;
+
+  if (argc > 1) {
+    pid = 0;
+    for (char *p = argv[1]; *p >= '0' && *p <= '9'; p++) pid = pid * 10 + *p - '0';
+  }
+
+  for (int nr = 0; nr < SYSCALL_STAT_NR; nr++) {
+    if (syscall_stat(pid, nr, &stats[nr]) < 0) {
+      if (nr == 0) {
+        printu("no counters: build the kernel with SYSCALL_STATS=1, and check the pid.\n");
+        exit(-1);
+      }
+      continue;
+    }
+    if (stats[nr].calls) order[n++] = nr;
+  }
+
+  // by total time, largest first
+  for (int i = 1; i < n; i++)
+    for (int j = i; j > 0 && stats[order[j]].cycles > stats[order[j - 1]].cycles; j--) {
+      int t = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = t;
+    }
+
+  printu("NR\tCALLS\tERRORS\tCYCLES\tAVG\tP50<\tP99<\tNAME\n");
+  for (int i = 0; i < n && i < TOP; i++) {
+    struct syscall_stat *st = &stats[order[i]];
+    printu("%d\t%ld\t%ld\t%ld\t%ld\t%ld\t%ld\t%s\n", order[i], st->calls, st->errors, st->cycles,
+           st->cycles / st->calls, percentile(st, 50), percentile(st, 99),
+           names[order[i]] ? names[order[i]] : "?");
+  }
+
+  exit(0);
+  return 0;
+}
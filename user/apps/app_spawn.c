@@ -0,0 +1,51 @@
+/*
+ * starts short tasks (this program again, with the argument "child") with fork and exec, with
+ * vfork and exec, and with spawn, which builds the child from the elf without copying the
+ * parent first:
+ *   make run-app_spawn
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+#define ROUNDS 20
+
+int main(int argc, char *argv[]) {
+  char *child_argv[] = { "app_spawn", "child", NULL };
+  uint64 start, ns;
+
+  if (argc > 1) exit(0);
+
+  start = gettime();
+  for (int i = 0; i < ROUNDS; i++) {
+    int pid = fork();
+    if (pid == 0) exec(child_argv[0], child_argv);
+    wait(pid);
+  }
+  ns = gettime() - start;
+  printu("fork+exec: %d tasks, %ld us per task\n", ROUNDS, ns / ROUNDS / 1000);
+
+  start = gettime();
+  for (int i = 0; i < ROUNDS; i++) {
+    int pid = vfork();
+    if (pid == 0) exec(child_argv[0], child_argv);
+    wait(pid);
+  }
+  ns = gettime() - start;
+  printu("vfork+exec: %d tasks, %ld us per task\n", ROUNDS, ns / ROUNDS / 1000);
+
+  start = gettime();
+  for (int i = 0; i < ROUNDS; i++) {
+    int pid = spawn(child_argv[0], child_argv, NULL);
+    if (pid < 0) {
+      printu("spawn failed.\n");
+      exit(-1);
+    }
+    wait(pid);
+  }
+  ns = gettime() - start;
+  printu("spawn: %d tasks, %ld us per task\n", ROUNDS, ns / ROUNDS / 1000);
+
+  exit(0);
+  return 0;
+}
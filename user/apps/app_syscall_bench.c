@@ -0,0 +1,38 @@
+/*
+ * measures the latency of a null system call (getpid), which takes the fast path of the trap
+ * vector, against reading the pid from the kernel data page (vdso). to compare with the full
+ * path, run the kernel with the boot argument syscall=slow:
+ *   make run-app_syscall_bench
+ *   make run-app_syscall_bench SPIKE_FLAGS='--bootargs="syscall=slow"'
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+
+#define ROUNDS 100000
+
+int main(int argc, char *argv[]) {
+  struct proc_stat before, after;
+  uint64 start, ns;
+
+  // warm up the caches and the tlb.
+  for (int i = 0; i < 100; i++) getpid();
+
+  getstat(0, &before);
+  start = gettime();
+  for (int i = 0; i < ROUNDS; i++) getpid();
+  ns = gettime() - start;
+  getstat(0, &after);
+
+  printu("getpid: %d calls, %ld ns per call\n", ROUNDS, ns / ROUNDS);
+  printu("        %ld user and %ld kernel cycles per call\n",
+         (after.ucycles - before.ucycles) / ROUNDS, (after.scycles - before.scycles) / ROUNDS);
+
+  start = vdso_gettime();
+  for (int i = 0; i < ROUNDS; i++) vdso_getpid();
+  ns = vdso_gettime() - start;
+  printu("vdso_getpid: %d calls, %ld ns per call\n", ROUNDS, ns / ROUNDS);
+
+  exit(0);
+  return 0;
+}
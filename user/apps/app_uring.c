@@ -0,0 +1,92 @@
+/*
+ * file i/o through the submission/completion rings: a few files on the RAM disk are
+ * opened, written, closed, opened again, read back and closed, each step one batch of
+ * operations with one system call, and every completion is checked.
+ *   make run-app_uring
+ */
+
+#include "user/user_lib.h"
+#include "util/types.h"
+#include "util/string.h"
+
+#define NFILES 4
+
+static char *paths[NFILES] = { "ramdisk0:/uring0", "ramdisk0:/uring1", "ramdisk0:/uring2",
+                               "ramdisk0:/uring3" };
+static char *texts[NFILES] = { "first file", "second file", "third file", "fourth file" };
+static char back[NFILES][32];
+
+static struct uring *ring;
+static int64 res[2 * NFILES];
+
+// queue one operation, tagged with its slot in res.
+static void queue(int op, int fd, uint64 addr, uint64 len, int tag) {
+  struct uring_sqe *sqe = uring_get_sqe(ring);
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->user_data = tag;
+}
+
+// run the n queued operations with one system call, and collect the results by tag.
+static int run(int n) {
+  struct uring_cqe *cqe;
+  int seen = 0;
+
+  if (uring_submit(ring) != n) return -1;
+  while ((cqe = uring_peek_cqe(ring))) {
+    res[cqe->user_data] = cqe->res;
+    uring_cqe_seen(ring);
+    seen++;
+  }
+  return seen == n ? 0 : -1;
+}
+
+// open all files in one batch, their descriptors go to fds.
+static int open_all(int flags, int *fds) {
+  for (int i = 0; i < NFILES; i++) queue(URING_OP_OPEN, 0, (uint64)paths[i], flags, i);
+  if (run(NFILES) != 0) return -1;
+  for (int i = 0; i < NFILES; i++)
+    if ((fds[i] = res[i]) < 0) return -1;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int fds[NFILES], ok = 1;
+
+  ring = uring_setup();
+  if (!ring || open_all(O_RDWR | O_CREATE, fds) != 0) {
+    printu("cannot set up the rings or open the files.\n");
+    exit(-1);
+  }
+
+  // the writes and the closes, in one call.
+  for (int i = 0; i < NFILES; i++)
+    queue(URING_OP_WRITE, fds[i], (uint64)texts[i], strlen(texts[i]) + 1, i);
+  for (int i = 0; i < NFILES; i++) queue(URING_OP_CLOSE, fds[i], 0, 0, NFILES + i);
+  if (run(2 * NFILES) != 0) ok = 0;
+  for (int i = 0; i < NFILES; i++)
+    if (res[i] != strlen(texts[i]) + 1 || res[NFILES + i] != 0) ok = 0;
+  printu("batch: %d writes and %d closes, %s\n", NFILES, NFILES, ok ? "ok" : "FAILED");
+
+  if (open_all(O_RDWR, fds) != 0) {
+    printu("cannot open the files again.\n");
+    exit(-1);
+  }
+
+  // the reads and the closes, in one call.
+  for (int i = 0; i < NFILES; i++)
+    queue(URING_OP_READ, fds[i], (uint64)back[i], sizeof(back[i]), i);
+  for (int i = 0; i < NFILES; i++) queue(URING_OP_CLOSE, fds[i], 0, 0, NFILES + i);
+  if (run(2 * NFILES) != 0) ok = 0;
+  for (int i = 0; i < NFILES; i++) {
+    if (res[i] != strlen(texts[i]) + 1 || res[NFILES + i] != 0) ok = 0;
+    if (strcmp(back[i], texts[i]) != 0) ok = 0;
+    printu("%s: \"%s\"\n", paths[i], back[i]);
+  }
+
+  printu(ok ? "completions ok.\n" : "completions MISMATCH.\n");
+  exit(0);
+  return 0;
+}
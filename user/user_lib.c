@@ -8,6 +8,7 @@
 #include "user_lib.h"
 #include "util/types.h"
 #include "util/snprintf.h"
+#include "util/string.h"
 #include "kernel/syscall.h"
 
 uint64 do_user_call(uint64 sysnum, uint64 a1, uint64 a2, uint64 a3, uint64 a4, uint64 a5, uint64 a6,
@@ -78,17 +79,10 @@ void yield() {
 }
 
 //
-// lab3_challenge1
+// lab3_challenge1. blocks in the kernel until the child (any child if pid is -1) exits.
 //
 int wait(int pid){
-  int ret = -1;
-  while (1){
-    ret = do_user_call(SYS_user_wait, pid, 0, 0, 0, 0, 0, 0);
-    if ( ret == -2 )  // waiting
-      yield();
-    else
-      return ret;
-  }
+  return do_user_call(SYS_user_wait, pid, 0, 0, 0, 0, 0, 0);
 }
 
 //
@@ -140,9 +134,251 @@ int close(int fd) {
   return do_user_call(SYS_user_close, fd, 0, 0, 0, 0, 0, 0);
 }
 
+//
+// lib calls to read into / write from the iovcnt buffers of iov, in one system call, at
+// the file position. return the number of bytes moved, or -1.
+//
+int readv(int fd, struct iovec *iov, int iovcnt) {
+  return do_user_call(SYS_user_readv, fd, (uint64)iov, iovcnt, 0, 0, 0, 0);
+}
+
+int writev(int fd, struct iovec *iov, int iovcnt) {
+  return do_user_call(SYS_user_writev, fd, (uint64)iov, iovcnt, 0, 0, 0, 0);
+}
+
+//
+// lib calls like readv and writev, at offset off of the file (its position stays)
+//
+int preadv(int fd, struct iovec *iov, int iovcnt, uint64 off) {
+  return do_user_call(SYS_user_preadv, fd, (uint64)iov, iovcnt, off, 0, 0, 0);
+}
+
+int pwritev(int fd, struct iovec *iov, int iovcnt, uint64 off) {
+  return do_user_call(SYS_user_pwritev, fd, (uint64)iov, iovcnt, off, 0, 0, 0);
+}
+
 //
 // lib call to get os information
 //
 int getinfo(){
   return do_user_call(SYS_user_getinfo, 0, 0, 0, 0, 0, 0, 0);
-}
\ No newline at end of file
+}
+
+//
+// lib call to set the nice value (cfs scheduling weight) of process pid, 0 for the caller.
+// returns the old nice value (-20 .. 19), or -21 if there is no such process: -1 is a
+// nice value.
+//
+int nice(int pid, int nice_value) {
+  return do_user_call(SYS_user_nice, pid, nice_value, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to sleep for ns nanoseconds
+//
+int nanosleep(uint64 ns) {
+  return do_user_call(SYS_user_nanosleep, ns, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to sleep until deadline_ns, in nanoseconds since boot (see gettime)
+//
+int sleep_until(uint64 deadline_ns) {
+  return do_user_call(SYS_user_sleep_until, deadline_ns, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to get the time since boot, in nanoseconds
+//
+uint64 gettime() {
+  return do_user_call(SYS_user_gettime, 0, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to wait for a child for at most timeout_ns nanoseconds. returns -2 on timeout.
+//
+int wait_timeout(int pid, uint64 timeout_ns) {
+  return do_user_call(SYS_user_wait_timeout, pid, gettime() + timeout_ns, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to get the cpu accounting of process pid (0 for the calling process)
+//
+int getstat(int pid, struct proc_stat *st) {
+  return do_user_call(SYS_user_getstat, pid, (uint64)st, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to run the calling process as a deadline process: it gets runtime_ns of processor
+// time in every period_ns, by deadline_ns after the period starts (period_ns 0: the same as
+// deadline_ns). yield() ends the job of the period. returns -1 if the parameters are invalid
+// or the system cannot admit the process. runtime_ns 0 makes it best-effort again.
+//
+int sched_deadline(uint64 runtime_ns, uint64 deadline_ns, uint64 period_ns) {
+  return do_user_call(SYS_user_sched_deadline, runtime_ns, deadline_ns, period_ns, 0, 0, 0, 0);
+}
+
+//
+// lib call to create a cpu group, whose processes together may run for quota_ns in every
+// period_ns. returns the group id, or -1.
+//
+int group_create(uint64 quota_ns, uint64 period_ns) {
+  return do_user_call(SYS_user_group_create, quota_ns, period_ns, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to move the calling process to group id. its children inherit the group.
+//
+int group_join(int id) {
+  return do_user_call(SYS_user_group_join, id, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to get the usage and throttled time of group id
+//
+int group_stat(int id, struct group_stat *st) {
+  return do_user_call(SYS_user_group_stat, id, (uint64)st, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to get the pid of the calling process
+//
+int getpid() {
+  return do_user_call(SYS_user_getpid, 0, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to get the counters of system call SYS_user_base + nr of process pid (0 for the
+// calling process, -1 for all processes). fails unless the kernel is built with
+// SYSCALL_STATS.
+//
+int syscall_stat(int pid, int nr, struct syscall_stat *st) {
+  return do_user_call(SYS_user_syscall_stat, pid, nr, (uint64)st, 0, 0, 0, 0);
+}
+
+//
+// lib call to start program path (a shell command) with the arguments argv in a new child:
+// fork and exec in one, without copying the calling process first. the child inherits the
+// open files, changed by the file actions in actions (may be NULL). returns its pid, or -1.
+//
+int spawn(const char *path, char *argv[], struct spawn_action *actions) {
+  return do_user_call(SYS_user_spawn, (uint64)path, (uint64)argv, (uint64)actions, 0, 0, 0, 0);
+}
+
+//
+// lib call to read the kernel log: the text of its records, oldest first, at most len bytes
+// (and a page). returns the number of bytes.
+//
+int dmesg(char *buf, uint64 len) {
+  return do_user_call(SYS_user_dmesg, (uint64)buf, len, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to map the submission/completion rings of the calling process. returns NULL if
+// they exist already.
+//
+struct uring *uring_setup() {
+  return (struct uring *)do_user_call(SYS_user_uring_setup, 0, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// lib call to run up to to_submit queued operations. returns the number run.
+//
+int uring_enter(int to_submit) {
+  return do_user_call(SYS_user_uring_enter, to_submit, 0, 0, 0, 0, 0, 0);
+}
+
+//
+// the next free submission slot, or NULL if the submission ring is full. it is queued
+// (sq_tail moves) here, fill it in before the next uring_submit.
+//
+struct uring_sqe *uring_get_sqe(struct uring *ring) {
+  if (ring->sq_tail - ring->sq_head >= URING_ENTRIES) return 0;
+  struct uring_sqe *sqe = &ring->sq[ring->sq_tail & (URING_ENTRIES - 1)];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_tail++;
+  return sqe;
+}
+
+//
+// run all queued operations, with one system call. returns the number run, less if the
+// completion ring filled up.
+//
+int uring_submit(struct uring *ring) {
+  return uring_enter(ring->sq_tail - ring->sq_head);
+}
+
+//
+// the oldest completion not yet seen, or NULL.
+//
+struct uring_cqe *uring_peek_cqe(struct uring *ring) {
+  if (ring->cq_head == ring->cq_tail) return 0;
+  return &ring->cq[ring->cq_head & (URING_ENTRIES - 1)];
+}
+
+//
+// release the completion returned by uring_peek_cqe.
+//
+void uring_cqe_seen(struct uring *ring) {
+  ring->cq_head++;
+}
+
+//
+// copy the kernel data page to vd. the kernel may be updating it on another hart, the copy
+// is taken again until it saw no update (see struct vdso_data).
+//
+void vdso_read(struct vdso_data *vd) {
+  volatile struct vdso_data *page = (volatile struct vdso_data *)VDSO_VA;
+  uint32 seq;
+
+  do {
+    while ((seq = page->seq) & 1)
+      ;
+    asm volatile("fence r, r" ::: "memory");
+    *vd = *page;
+    asm volatile("fence r, r" ::: "memory");
+  } while (page->seq != seq);
+}
+
+//
+// scheduler ticks since boot, as of the last return from the kernel
+//
+uint64 vdso_ticks() {
+  struct vdso_data vd;
+  vdso_read(&vd);
+  return vd.ticks;
+}
+
+//
+// the time since boot in nanoseconds, as returned by gettime. mtime is read directly
+// (rdtime).
+//
+uint64 vdso_gettime() {
+  volatile struct vdso_data *vd = (volatile struct vdso_data *)VDSO_VA;
+  uint64 timebase = vd->timebase, time;
+  asm volatile("rdtime %0" : "=r"(time));
+  return (time - vd->boot_time) * 1000000 / (timebase / 1000);
+}
+
+int vdso_getpid() {
+  return ((volatile struct vdso_data *)VDSO_VA)->pid;
+}
+
+//
+// processes running or ready to run on all harts, as of the last return from the kernel
+//
+uint64 vdso_nr_running() {
+  struct vdso_data vd;
+  vdso_read(&vd);
+  return vd.nr_running;
+}
+
+//
+// the cpu accounting of the calling process (see getstat), as of the last return from the
+// kernel
+//
+void vdso_getstat(struct proc_stat *st) {
+  struct vdso_data vd;
+  vdso_read(&vd);
+  *st = vd.stat;
+}
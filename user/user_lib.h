@@ -3,6 +3,13 @@
  */
 
 #include "util/types.h"
+#include "kernel/proc_stat.h"
+#include "kernel/uring.h"
+#include "kernel/vdso.h"
+#include "kernel/syscall_stat.h"
+#include "kernel/uio.h"
+#include "kernel/spawn.h"
+#include "kernel/syscall.h"
 
 int printu(const char *s, ...);
 int exit(int code);
@@ -13,11 +20,57 @@ int wait(int pid);
 void yield();
 int getlineu(char * dst, int size);
 int exec(char * path, char ** argv);
+int spawn(const char *path, char *argv[], struct spawn_action *actions);
+
+//
+// vfork: the child runs on the address space (and the stack) of the caller, which waits
+// until the child calls exec or exit. the child must not return from the function that
+// called vfork; vfork itself makes the system call inline, without a frame of its own that
+// the child could overwrite.
+//
+static inline __attribute__((always_inline)) int vfork() {
+  register long a0 asm("a0") = SYS_user_vfork;
+  asm volatile("ecall" : "+r"(a0) : : "memory");
+  return a0;
+}
 int getinfo();
+int nice(int pid, int nice_value);
+int nanosleep(uint64 ns);
+int sleep_until(uint64 deadline_ns);
+uint64 gettime();
+int wait_timeout(int pid, uint64 timeout_ns);
+int getstat(int pid, struct proc_stat *st);
+int sched_deadline(uint64 runtime_ns, uint64 deadline_ns, uint64 period_ns);
+int group_create(uint64 quota_ns, uint64 period_ns);
+int group_join(int id);
+int group_stat(int id, struct group_stat *st);
+int getpid();
+int syscall_stat(int pid, int nr, struct syscall_stat *st);
+int dmesg(char *buf, uint64 len);
+
+// batched system calls
+struct uring *uring_setup();
+int uring_enter(int to_submit);
+struct uring_sqe *uring_get_sqe(struct uring *ring);
+int uring_submit(struct uring *ring);
+struct uring_cqe *uring_peek_cqe(struct uring *ring);
+void uring_cqe_seen(struct uring *ring);
+
+// counters of the kernel data page, read without a system call
+void vdso_read(struct vdso_data *vd);
+uint64 vdso_ticks();
+uint64 vdso_gettime();
+int vdso_getpid();
+uint64 vdso_nr_running();
+void vdso_getstat(struct proc_stat *st);
 
 // file
 int open(const char *pathname, int flags);
 int create(const char *pathname);
 int read(int fd, void *buf, uint64 count);
 int write(int fd, void *buf, uint64 count);
-int close(int fd);
\ No newline at end of file
+int close(int fd);
+int readv(int fd, struct iovec *iov, int iovcnt);
+int writev(int fd, struct iovec *iov, int iovcnt);
+int preadv(int fd, struct iovec *iov, int iovcnt, uint64 off);
+int pwritev(int fd, struct iovec *iov, int iovcnt, uint64 off);
\ No newline at end of file
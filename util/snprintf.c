@@ -81,3 +81,11 @@ int32 vsnprintf(char* out, size_t n, const char* s, va_list vl) {
     out[n - 1] = 0;
   return pos;
 }
+
+int32 snprintf(char* out, size_t n, const char* s, ...) {
+  va_list vl;
+  va_start(vl, s);
+  int32 res = vsnprintf(out, n, s, vl);
+  va_end(vl);
+  return res;
+}
@@ -38,6 +38,24 @@ void* memset(void* dest, int byte, size_t len) {
   return dest;
 }
 
+int memcmp(const void* s1, const void* s2, size_t len) {
+  const unsigned char* p1 = s1;
+  const unsigned char* p2 = s2;
+
+  if ((((uintptr_t)s1 | (uintptr_t)s2 | len) & (sizeof(uintptr_t) - 1)) == 0) {
+    // compare word by word, and fall back to bytes at the first difference.
+    while (len && *(const uintptr_t*)p1 == *(const uintptr_t*)p2) {
+      p1 += sizeof(uintptr_t);
+      p2 += sizeof(uintptr_t);
+      len -= sizeof(uintptr_t);
+    }
+  }
+
+  for (; len; len--, p1++, p2++)
+    if (*p1 != *p2) return *p1 - *p2;
+  return 0;
+}
+
 size_t strlen(const char* s) {
   const char* p = s;
   while (*p) p++;